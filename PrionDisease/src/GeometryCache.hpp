@@ -0,0 +1,319 @@
+#ifndef GEOMETRY_CACHE_HPP
+#define GEOMETRY_CACHE_HPP
+
+#include <deal.II/base/aligned_vector.h>
+#include <deal.II/base/memory_consumption.h>
+#include <deal.II/base/quadrature.h>
+#include <deal.II/base/tensor.h>
+#include <deal.II/base/vectorization.h>
+
+#include <deal.II/dofs/dof_handler.h>
+
+#include <deal.II/fe/fe_values.h>
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+using namespace dealii;
+
+// Geometry and shape function data of the locally owned cells, computed once
+// for every mesh the simulation runs on. Every quantity is
+// stored in its own contiguous array, in the order in which the owned cells
+// are visited by DoFHandler::active_cell_iterators(), so that the assembly
+// loops can stream through them instead of calling FEValues::reinit().
+template <int dim>
+class CellGeometryCache {
+public:
+  using CellIterator = typename DoFHandler<dim>::active_cell_iterator;
+
+  // Diffusivity tensor of a cell, also given its index among the owned cells.
+  using CellDiffusivity = std::function<Tensor<2, dim>(const CellIterator &, const unsigned int &)>;
+
+  // Reaction coefficient at the q-th quadrature node of a cell, on which the
+  // FEValues object is initialized.
+  using CellReaction =
+    std::function<double(const CellIterator &, const FEValues<dim> &, const unsigned int &)>;
+
+  // Fill the cache. The diffusivity of every cell is pre-contracted with the
+  // shape function gradients, and alpha is evaluated once at every
+  // quadrature node, with alpha_flags added to the update flags.
+  void
+  reinit(const DoFHandler<dim> &dof_handler,
+         const Quadrature<dim> &quadrature,
+         const CellDiffusivity &D,
+         const CellReaction    &alpha,
+         const UpdateFlags     &alpha_flags = update_default);
+
+  // Number of cached cells.
+  unsigned int
+  n_cells() const {
+    return n_cached_cells;
+  }
+
+  // Number of quadrature points per cell.
+  unsigned int
+  n_q_points() const {
+    return n_q;
+  }
+
+  // Number of DoFs per cell.
+  unsigned int
+  dofs_per_cell() const {
+    return n_dofs;
+  }
+
+  // Value of the i-th shape function at the q-th quadrature node. Values on
+  // the reference cell do not depend on the mapping, so they are shared by
+  // all cells.
+  double
+  shape_value(const unsigned int i, const unsigned int q) const {
+    return shape_values[q * n_dofs + i];
+  }
+
+  // JxW values of a cell, one per quadrature node.
+  const double *
+  JxW(const unsigned int cell) const {
+    return &JxW_values[cell * n_q];
+  }
+
+  // Mapped shape function gradients of a cell, indexed by q * dofs_per_cell + i.
+  const Tensor<1, dim> *
+  shape_gradients(const unsigned int cell) const {
+    return &gradients[cell * n_q * n_dofs];
+  }
+
+  // Products D grad(phi_i) of a cell, indexed as shape_gradients().
+  const Tensor<1, dim> *
+  D_shape_gradients(const unsigned int cell) const {
+    return &D_gradients[cell * n_q * n_dofs];
+  }
+
+  // Values of alpha at the quadrature nodes of a cell.
+  const double *
+  alpha(const unsigned int cell) const {
+    return &alpha_values[cell * n_q];
+  }
+
+  // Global DoF indices of a cell.
+  const types::global_dof_index *
+  dof_indices(const unsigned int cell) const {
+    return &indices[cell * n_dofs];
+  }
+
+  // Memory used by the cache, in bytes.
+  std::size_t
+  memory_consumption() const {
+    return MemoryConsumption::memory_consumption(shape_values) +
+           MemoryConsumption::memory_consumption(JxW_values) +
+           MemoryConsumption::memory_consumption(gradients) +
+           MemoryConsumption::memory_consumption(D_gradients) +
+           MemoryConsumption::memory_consumption(alpha_values) +
+           MemoryConsumption::memory_consumption(indices);
+  }
+
+private:
+  unsigned int n_cached_cells = 0;
+  unsigned int n_q            = 0;
+  unsigned int n_dofs         = 0;
+
+  std::vector<double>                  shape_values;
+  std::vector<double>                  JxW_values;
+  std::vector<Tensor<1, dim>>          gradients;
+  std::vector<Tensor<1, dim>>          D_gradients;
+  std::vector<double>                  alpha_values;
+  std::vector<types::global_dof_index> indices;
+};
+
+template <int dim>
+void
+CellGeometryCache<dim>::reinit(const DoFHandler<dim> &dof_handler,
+                               const Quadrature<dim> &quadrature,
+                               const CellDiffusivity &D,
+                               const CellReaction    &alpha,
+                               const UpdateFlags     &alpha_flags) {
+  n_cached_cells = dof_handler.get_triangulation().n_locally_owned_active_cells();
+  n_q            = quadrature.size();
+  n_dofs         = dof_handler.get_fe().dofs_per_cell;
+
+  FEValues<dim> fe_values(dof_handler.get_fe(),
+                          quadrature,
+                          update_values | update_gradients | update_JxW_values | alpha_flags);
+
+  shape_values.resize(n_q * n_dofs);
+  JxW_values.resize(n_cached_cells * n_q);
+  gradients.resize(n_cached_cells * n_q * n_dofs);
+  D_gradients.resize(n_cached_cells * n_q * n_dofs);
+  alpha_values.resize(n_cached_cells * n_q);
+  indices.resize(n_cached_cells * n_dofs);
+
+  std::vector<types::global_dof_index> cell_indices(n_dofs);
+
+  unsigned int cell_index = 0;
+
+    for (const auto &cell : dof_handler.active_cell_iterators()) {
+      if (!cell->is_locally_owned())
+        continue;
+
+      fe_values.reinit(cell);
+
+      const Tensor<2, dim> D_cell = D(cell, cell_index);
+
+      if (cell_index == 0)
+        for (unsigned int q = 0; q < n_q; ++q)
+          for (unsigned int i = 0; i < n_dofs; ++i)
+            shape_values[q * n_dofs + i] = fe_values.shape_value(i, q);
+
+        for (unsigned int q = 0; q < n_q; ++q) {
+          JxW_values[cell_index * n_q + q]   = fe_values.JxW(q);
+          alpha_values[cell_index * n_q + q] = alpha(cell, fe_values, q);
+
+            for (unsigned int i = 0; i < n_dofs; ++i) {
+              const unsigned int k = (cell_index * n_q + q) * n_dofs + i;
+
+              gradients[k]   = fe_values.shape_grad(i, q);
+              D_gradients[k] = D_cell * gradients[k];
+            }
+        }
+
+      cell->get_dof_indices(cell_indices);
+      std::copy(cell_indices.begin(), cell_indices.end(), &indices[cell_index * n_dofs]);
+
+      ++cell_index;
+    }
+}
+
+// The data of a CellGeometryCache, regrouped in batches of
+// VectorizedArray<double>::size() consecutive cells: lane v of every array of
+// a batch belongs to its v-th cell, so that the SIMD kernels load whole
+// vectors instead of filling them one lane at a time. The DoF indices are
+// local indices into the ghosted vectors, which the kernels read without
+// looking up the global ones.
+template <int dim>
+class CellBatchCache {
+public:
+  using VA = VectorizedArray<double>;
+
+  static constexpr unsigned int n_lanes = VA::size();
+
+  // Local index, in the ghosted vectors, of a global DoF index.
+  using LocalIndex = std::function<unsigned int(const types::global_dof_index &)>;
+
+  // Fill the batches from the cells of the given cache. The empty lanes of
+  // the last batch repeat its last cell.
+  void
+  reinit(const CellGeometryCache<dim> &cache, const LocalIndex &local_index);
+
+  // Number of batches.
+  unsigned int
+  n_batches() const {
+    return n_cell_batches;
+  }
+
+  // Number of quadrature points per cell.
+  unsigned int
+  n_q_points() const {
+    return n_q;
+  }
+
+  // Number of cells in a batch (less than n_lanes for the last one only).
+  unsigned int
+  n_filled(const unsigned int batch) const {
+    return std::min(n_lanes, n_cached_cells - batch * n_lanes);
+  }
+
+  // JxW values of a batch, one per quadrature node.
+  const VA *
+  JxW(const unsigned int batch) const {
+    return &JxW_values[batch * n_q];
+  }
+
+  // Values of alpha at the quadrature nodes of a batch.
+  const VA *
+  alpha(const unsigned int batch) const {
+    return &alpha_values[batch * n_q];
+  }
+
+  // Mapped shape function gradients of a batch, indexed by
+  // q * dofs_per_cell + i.
+  const Tensor<1, dim, VA> *
+  shape_gradients(const unsigned int batch) const {
+    return &gradients[batch * n_q * n_dofs];
+  }
+
+  // Products D grad(phi_i) of a batch, indexed as shape_gradients().
+  const Tensor<1, dim, VA> *
+  D_shape_gradients(const unsigned int batch) const {
+    return &D_gradients[batch * n_q * n_dofs];
+  }
+
+  // Local DoF indices of a batch, indexed by i * n_lanes + v, as the offsets
+  // of VectorizedArray::gather().
+  const unsigned int *
+  local_dof_indices(const unsigned int batch) const {
+    return &local_indices[batch * n_dofs * n_lanes];
+  }
+
+  // Memory used by the cache, in bytes.
+  std::size_t
+  memory_consumption() const {
+    return JxW_values.memory_consumption() + alpha_values.memory_consumption() +
+           gradients.memory_consumption() + D_gradients.memory_consumption() +
+           MemoryConsumption::memory_consumption(local_indices);
+  }
+
+private:
+  unsigned int n_cached_cells = 0;
+  unsigned int n_cell_batches = 0;
+  unsigned int n_q            = 0;
+  unsigned int n_dofs         = 0;
+
+  AlignedVector<VA>                 JxW_values;
+  AlignedVector<VA>                 alpha_values;
+  AlignedVector<Tensor<1, dim, VA>> gradients;
+  AlignedVector<Tensor<1, dim, VA>> D_gradients;
+  std::vector<unsigned int>         local_indices;
+};
+
+template <int dim>
+void
+CellBatchCache<dim>::reinit(const CellGeometryCache<dim> &cache, const LocalIndex &local_index) {
+  n_cached_cells = cache.n_cells();
+  n_cell_batches = (n_cached_cells + n_lanes - 1) / n_lanes;
+  n_q            = cache.n_q_points();
+  n_dofs         = cache.dofs_per_cell();
+
+  JxW_values.resize(n_cell_batches * n_q);
+  alpha_values.resize(n_cell_batches * n_q);
+  gradients.resize(n_cell_batches * n_q * n_dofs);
+  D_gradients.resize(n_cell_batches * n_q * n_dofs);
+  local_indices.resize(n_cell_batches * n_dofs * n_lanes);
+
+    for (unsigned int b = 0; b < n_cell_batches; ++b) {
+        for (unsigned int v = 0; v < n_lanes; ++v) {
+          const unsigned int c = b * n_lanes + std::min(v, n_filled(b) - 1);
+
+          const Tensor<1, dim>          *cell_grad   = cache.shape_gradients(c);
+          const Tensor<1, dim>          *cell_D_grad = cache.D_shape_gradients(c);
+          const types::global_dof_index *indices     = cache.dof_indices(c);
+
+            for (unsigned int q = 0; q < n_q; ++q) {
+              JxW_values[b * n_q + q][v]   = cache.JxW(c)[q];
+              alpha_values[b * n_q + q][v] = cache.alpha(c)[q];
+
+              for (unsigned int i = 0; i < n_dofs; ++i)
+                for (unsigned int d = 0; d < dim; ++d) {
+                  const unsigned int k = (b * n_q + q) * n_dofs + i;
+
+                  gradients[k][d][v]   = cell_grad[q * n_dofs + i][d];
+                  D_gradients[k][d][v] = cell_D_grad[q * n_dofs + i][d];
+                }
+            }
+
+          for (unsigned int i = 0; i < n_dofs; ++i)
+            local_indices[(b * n_dofs + i) * n_lanes + v] = local_index(indices[i]);
+        }
+    }
+}
+
+#endif
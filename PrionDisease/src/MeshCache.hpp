@@ -0,0 +1,215 @@
+#ifndef MESH_CACHE_HPP
+#define MESH_CACHE_HPP
+
+#include <deal.II/base/exceptions.h>
+
+#include <deal.II/grid/tria.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "SimplexMesh.hpp"
+
+using namespace dealii;
+
+// Binary copy of a coarse simplex mesh and of a partition of its cells, written
+// by the convert_mesh tool and read back by mapping the file in memory, so
+// that repeated runs neither parse the Gmsh file, nor build a serial
+// Triangulation, nor partition the mesh.
+//
+// Layout (native endianness): a header of Header::n_fields 64-bit integers,
+// then the vertex coordinates (doubles), and then 32-bit integers: the cell
+// vertices, the cell material ids, the cell subdomains and, for every
+// boundary face with a non-zero boundary id, its vertices followed by the id.
+namespace MeshCache {
+  // First bytes of every cache file.
+  constexpr std::uint64_t magic = 0x48534D4E4F495250; // "PRIONMSH"
+
+  // Incremented whenever the layout changes.
+  constexpr std::uint64_t version = 1;
+
+  struct Header {
+    static constexpr unsigned int n_fields = 8;
+
+    std::uint64_t magic;
+    std::uint64_t version;
+    std::uint64_t dim;
+    std::uint64_t n_vertices;
+    std::uint64_t n_cells;
+    std::uint64_t n_boundary_faces;
+    std::uint64_t n_partitions;
+    std::uint64_t reserved;
+  };
+
+  static_assert(sizeof(Header) == Header::n_fields * sizeof(std::uint64_t),
+                "Unexpected padding in the mesh cache header.");
+
+  // Whether the given file is a mesh cache.
+  inline bool
+  is_cache_file(const std::string &file_name) {
+    std::ifstream file(file_name, std::ios::binary);
+    std::uint64_t file_magic = 0;
+    file.read(reinterpret_cast<char *>(&file_magic), sizeof(file_magic));
+    return file && file_magic == magic;
+  }
+
+  // Write the coarse cells of a serial mesh, with their subdomain ids as the
+  // partition into n_partitions parts.
+  template <int dim>
+  void
+  write(const Triangulation<dim> &mesh,
+        const unsigned int       &n_partitions,
+        const std::string        &file_name) {
+    AssertThrow(mesh.n_levels() == 1,
+                ExcMessage("Only coarse meshes can be written to a mesh cache."));
+
+    const unsigned int n_cell_vertices = dim + 1;
+    const unsigned int n_face_vertices = dim;
+
+    std::vector<std::uint32_t> cell_vertices;
+    std::vector<std::uint32_t> material_ids;
+    std::vector<std::uint32_t> subdomain_ids;
+    std::vector<std::uint32_t> boundary_faces;
+
+      for (const auto &cell : mesh.active_cell_iterators()) {
+        AssertThrow(cell->n_vertices() == n_cell_vertices,
+                    ExcMessage("Only simplex meshes can be written to a mesh cache."));
+
+        for (unsigned int v = 0; v < n_cell_vertices; ++v)
+          cell_vertices.push_back(cell->vertex_index(v));
+        material_ids.push_back(cell->material_id());
+        subdomain_ids.push_back(cell->subdomain_id());
+
+          for (const auto f : cell->face_indices()) {
+            const auto face = cell->face(f);
+            if (!face->at_boundary() || face->boundary_id() == 0)
+              continue;
+
+            for (unsigned int v = 0; v < n_face_vertices; ++v)
+              boundary_faces.push_back(face->vertex_index(v));
+            boundary_faces.push_back(face->boundary_id());
+          }
+      }
+
+    const Header header = {magic,
+                           version,
+                           dim,
+                           mesh.n_vertices(),
+                           mesh.n_active_cells(),
+                           boundary_faces.size() / (n_face_vertices + 1),
+                           n_partitions,
+                           0};
+
+    std::ofstream file(file_name, std::ios::binary);
+    AssertThrow(file, ExcMessage("Cannot open " + file_name + " for writing."));
+
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+      for (const auto &vertex : mesh.get_vertices()) {
+        for (unsigned int d = 0; d < dim; ++d) {
+          const double x = vertex[d];
+          file.write(reinterpret_cast<const char *>(&x), sizeof(x));
+        }
+      }
+
+    for (const auto *data : {&cell_vertices, &material_ids, &subdomain_ids, &boundary_faces})
+      file.write(reinterpret_cast<const char *>(data->data()),
+                 data->size() * sizeof(std::uint32_t));
+
+    AssertThrow(file, ExcMessage("Error while writing " + file_name + "."));
+  }
+
+  // Read a cache file into a simplex mesh, with the stored partition, and
+  // return the number of parts of the partition.
+  template <int dim>
+  unsigned int
+  read(const std::string         &file_name,
+       SimplexMesh<dim>          &mesh,
+       std::vector<unsigned int> &partition) {
+    const int fd = open(file_name.c_str(), O_RDONLY);
+    AssertThrow(fd >= 0, ExcMessage("Cannot open the mesh cache " + file_name));
+
+    struct stat file_stat;
+    fstat(fd, &file_stat);
+    const std::size_t size = file_stat.st_size;
+
+    void *address = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    AssertThrow(address != MAP_FAILED, ExcMessage("Cannot map the mesh cache " + file_name));
+
+    const char *data = static_cast<const char *>(address);
+
+    Header header;
+    std::memcpy(&header, data, sizeof(header));
+
+    AssertThrow(size >= sizeof(header) && header.magic == magic &&
+                  header.version == version && header.dim == dim,
+                ExcMessage(file_name + " is not a mesh cache for this version and dimension."));
+
+    using Cell = typename SimplexMesh<dim>::Cell;
+    using Face = typename SimplexMesh<dim>::Face;
+
+    const unsigned int n_cell_vertices = dim + 1;
+    const unsigned int n_face_vertices = dim;
+
+    const double *coordinates = reinterpret_cast<const double *>(data + sizeof(header));
+    const std::uint32_t *cell_vertices =
+      reinterpret_cast<const std::uint32_t *>(coordinates + header.n_vertices * dim);
+    const std::uint32_t *material_ids  = cell_vertices + header.n_cells * n_cell_vertices;
+    const std::uint32_t *subdomain_ids = material_ids + header.n_cells;
+    const std::uint32_t *boundary_faces = subdomain_ids + header.n_cells;
+
+    AssertThrow(reinterpret_cast<const char *>(
+                  boundary_faces + header.n_boundary_faces * (n_face_vertices + 1)) <=
+                  data + size,
+                ExcMessage(file_name + " is truncated."));
+
+    std::vector<Point<dim>> vertices(header.n_vertices);
+    for (std::size_t i = 0; i < header.n_vertices; ++i)
+      for (unsigned int d = 0; d < dim; ++d)
+        vertices[i][d] = coordinates[i * dim + d];
+
+    std::vector<Cell>               cells(header.n_cells);
+    std::vector<types::material_id> cell_material_ids(header.n_cells);
+      for (std::size_t c = 0; c < header.n_cells; ++c) {
+        std::copy(cell_vertices + c * n_cell_vertices,
+                  cell_vertices + (c + 1) * n_cell_vertices,
+                  cells[c].begin());
+        cell_material_ids[c] = material_ids[c];
+      }
+
+    std::map<Face, types::boundary_id> boundary_ids;
+      for (std::size_t f = 0; f < header.n_boundary_faces; ++f) {
+        const std::uint32_t *face = boundary_faces + f * (n_face_vertices + 1);
+
+        Face vertices_of_face;
+        std::copy(face, face + n_face_vertices, vertices_of_face.begin());
+        std::sort(vertices_of_face.begin(), vertices_of_face.end());
+        boundary_ids[vertices_of_face] = face[n_face_vertices];
+      }
+
+    partition.assign(subdomain_ids, subdomain_ids + header.n_cells);
+
+    const unsigned int n_partitions = header.n_partitions;
+
+    munmap(address, size);
+
+    mesh.reinit(std::move(vertices),
+                std::move(cells),
+                std::move(cell_material_ids),
+                std::move(boundary_ids));
+
+    return n_partitions;
+  }
+} // namespace MeshCache
+
+#endif
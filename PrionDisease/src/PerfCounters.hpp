@@ -0,0 +1,211 @@
+#ifndef PERF_COUNTERS_HPP
+#define PERF_COUNTERS_HPP
+
+#ifdef __linux__
+#  include <linux/perf_event.h>
+#  include <sys/ioctl.h>
+#  include <sys/syscall.h>
+#endif
+
+#include <unistd.h>
+
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Hardware performance counters of the calling thread, read with Linux
+// perf_event_open() at the boundaries of named sections, which may nest like
+// those of TimerOutput. A section accumulates the counts between every
+// enter() and the matching leave().
+//
+// The counters are cycles, instructions and last level cache misses, and
+// optionally a raw, processor-specific event counting floating point
+// operations. They are opened as one group, so that they are scheduled
+// together, and scaled if the kernel multiplexes them. When they cannot be
+// opened (not Linux, perf_event_paranoid too restrictive, a virtual machine
+// without a PMU), the object is disabled, status() says why, and enter() and
+// leave() do nothing.
+class PerfCounters {
+public:
+  // Counted events, indexing Counts::values.
+  enum Event : unsigned int { cycles, instructions, cache_misses, flops, n_events };
+
+  // Totals of a section.
+  struct Counts {
+    std::array<double, n_events> values = {};
+    unsigned long long           n_calls = 0;
+  };
+
+  // Open the counters if enabled, with the given raw event for the floating
+  // point operations (0: not counted).
+  PerfCounters(const bool &enabled, const std::uint64_t &flops_event = 0) {
+    fds.fill(-1);
+    ids.fill(0);
+
+      if (!enabled) {
+        status_message = "disabled";
+        return;
+      }
+
+#ifdef __linux__
+    const std::array<std::pair<std::uint32_t, std::uint64_t>, n_events> events = {
+      {{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+       {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+       {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+       {PERF_TYPE_RAW, flops_event}}};
+
+      for (unsigned int e = 0; e < n_events; ++e) {
+        if (e == flops && flops_event == 0)
+          continue;
+
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size           = sizeof(attr);
+        attr.type           = events[e].first;
+        attr.config         = events[e].second;
+        attr.disabled       = (e == cycles);
+        attr.exclude_kernel = 1;
+        attr.exclude_hv     = 1;
+        attr.read_format    = PERF_FORMAT_GROUP | PERF_FORMAT_ID |
+                           PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        // This thread, on any processor, in the group of the cycles.
+        fds[e] = static_cast<int>(
+          syscall(SYS_perf_event_open, &attr, 0, -1, (e == cycles) ? -1 : fds[cycles], 0));
+
+          if (fds[e] < 0) {
+            // Without the group leader, nothing can be counted; the other
+            // events are just left out.
+              if (e == cycles) {
+                status_message = std::string("perf_event_open failed: ") + std::strerror(errno) +
+                                 " (see /proc/sys/kernel/perf_event_paranoid)";
+                return;
+              }
+            continue;
+          }
+
+        ioctl(fds[e], PERF_EVENT_IOC_ID, &ids[e]);
+      }
+
+    ioctl(fds[cycles], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(fds[cycles], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+
+    status_message = "available";
+#else
+    (void)flops_event;
+    status_message = "only available on Linux";
+#endif
+  }
+
+  PerfCounters(const PerfCounters &) = delete;
+
+  PerfCounters &
+  operator=(const PerfCounters &) = delete;
+
+  ~PerfCounters() {
+    for (const int &fd : fds)
+      if (fd >= 0)
+        close(fd);
+  }
+
+  // Whether the counters are open.
+  bool
+  available() const {
+    return fds[cycles] >= 0;
+  }
+
+  // Whether the given event is counted.
+  bool
+  counts(const Event &event) const {
+    return fds[event] >= 0;
+  }
+
+  // Why the counters are not available (or "available").
+  const std::string &
+  status() const {
+    return status_message;
+  }
+
+  // Start counting for a section.
+  void
+  enter(const std::string &section) {
+    if (available())
+      stack.emplace_back(section, read());
+  }
+
+  // Stop counting for the last section entered.
+  void
+  leave() {
+    if (!available() || stack.empty())
+      return;
+
+    const std::array<double, n_events> values = read();
+    Counts                            &section = section_counts[stack.back().first];
+
+    for (unsigned int e = 0; e < n_events; ++e)
+      section.values[e] += values[e] - stack.back().second[e];
+    ++section.n_calls;
+
+    stack.pop_back();
+  }
+
+  // Totals of every section left so far.
+  const std::map<std::string, Counts> &
+  sections() const {
+    return section_counts;
+  }
+
+  // Size of a cache line, which is the traffic of a cache miss.
+  static unsigned int
+  cache_line_size() {
+#ifdef _SC_LEVEL1_DCACHE_LINESIZE
+    const long size = sysconf(_SC_LEVEL1_DCACHE_LINESIZE);
+    if (size > 0)
+      return static_cast<unsigned int>(size);
+#endif
+    return 64;
+  }
+
+private:
+  // Current value of every counter since the group was enabled, scaled by the
+  // fraction of time it was actually counting.
+  std::array<double, n_events>
+  read() const {
+    std::array<double, n_events> values = {};
+
+#ifdef __linux__
+    // Number of events, times enabled and running, then (value, id) pairs.
+    std::uint64_t buffer[3 + 2 * n_events];
+    if (::read(fds[cycles], buffer, sizeof(buffer)) <= 0)
+      return values;
+
+    const double scaling =
+      (buffer[2] > 0) ? static_cast<double>(buffer[1]) / static_cast<double>(buffer[2]) : 0.0;
+
+    for (std::uint64_t k = 0; k < buffer[0]; ++k)
+      for (unsigned int e = 0; e < n_events; ++e)
+        if (fds[e] >= 0 && ids[e] == buffer[4 + 2 * k])
+          values[e] = static_cast<double>(buffer[3 + 2 * k]) * scaling;
+#endif
+
+    return values;
+  }
+
+  // File descriptors (-1 if not counted) and ids of the events.
+  std::array<int, n_events>           fds;
+  std::array<std::uint64_t, n_events> ids;
+
+  std::string status_message;
+
+  // Sections entered and not left yet, with the counters when entered.
+  std::vector<std::pair<std::string, std::array<double, n_events>>> stack;
+
+  std::map<std::string, Counts> section_counts;
+};
+
+#endif
@@ -1,31 +1,178 @@
 #include "Prion.hpp"
 
+#include <cctype>
+#include <cstdio>
+#include <limits>
+#include <set>
+#include <sstream>
+#include <tuple>
+#include <unordered_map>
+
+namespace {
+  // Header of a checkpoint file, followed by one record per coarse cell
+  // holding the DoF values of the solution, of the previous solution and, if
+  // has_time_derivative, of the time derivative of the theta method.
+  struct CheckpointHeader {
+    std::uint64_t magic;
+    std::uint64_t version;
+    std::uint64_t n_cells;
+    std::uint64_t dofs_per_cell;
+    std::uint64_t time_step;
+    std::uint64_t n_output;
+    double        time;
+    double        deltat;
+    double        next_output;
+    double        deltat_previous;
+    double        error_norm_old;
+    std::uint64_t has_time_derivative;
+  };
+
+  constexpr std::uint64_t checkpoint_magic   = 0x4B48434E4F495250; // "PRIONCHK"
+  constexpr std::uint64_t checkpoint_version = 2;
+
+  // Smallest number of nodes handed to a thread by the node-by-node loops.
+  constexpr unsigned int nodal_grain_size = 4096;
+
+  // Cells with their coarse cell id.
+  template <int dim>
+  using CellsById =
+    std::vector<std::pair<types::coarse_cell_id, typename DoFHandler<dim>::active_cell_iterator>>;
+
+  // Locally owned cells, sorted by coarse cell id as MPI-IO file views need
+  // increasing offsets.
+  template <int dim>
+  CellsById<dim>
+  owned_cells_by_coarse_id(const DoFHandler<dim> &dof_handler) {
+    CellsById<dim> cells;
+
+    for (const auto &cell : dof_handler.active_cell_iterators())
+      if (cell->is_locally_owned())
+        cells.emplace_back(cell->id().get_coarse_cell_id(), cell);
+
+    std::sort(cells.begin(), cells.end(), [](const auto &a, const auto &b) {
+      return a.first < b.first;
+    });
+
+    return cells;
+  }
+
+  // File view selecting the records of the given cells, after the header.
+  template <int dim>
+  MPI_Datatype
+  make_checkpoint_view(const CellsById<dim> &cells, const unsigned int &record_size) {
+    std::vector<MPI_Aint> displacements;
+    displacements.reserve(cells.size());
+    for (const auto &cell : cells)
+      displacements.push_back(cell.first * record_size * sizeof(double));
+
+    MPI_Datatype view;
+    MPI_Type_create_hindexed_block(
+      cells.size(), record_size, displacements.data(), MPI_DOUBLE, &view);
+    MPI_Type_commit(&view);
+
+    return view;
+  }
+
+  // Reduction of analytics buffers, sent as one element of a contiguous
+  // datatype so that MPI never splits them: the first value is the number n
+  // of sums, which is the same everywhere, followed by n values to add and by
+  // values to take the maximum of.
+  void
+  reduce_sums_and_maxima(void *in, void *inout, int *length, MPI_Datatype *type) {
+    int size;
+    MPI_Type_size(*type, &size);
+    const unsigned int n_values = size / sizeof(double);
+
+    const double *a = static_cast<const double *>(in);
+    double       *b = static_cast<double *>(inout);
+
+      for (int e = 0; e < *length; ++e, a += n_values, b += n_values) {
+        const unsigned int n_sums = b[0];
+        for (unsigned int i = 1; i <= n_sums; ++i)
+          b[i] += a[i];
+        for (unsigned int i = n_sums + 1; i < n_values; ++i)
+          b[i] = std::max(a[i], b[i]);
+      }
+  }
+
+  // Drop the rows of a CSV or JSON lines log that were written after the given
+  // time step, which a run restarted from it writes again. Lines that do not
+  // start with a time step (the CSV header) are kept.
+  void
+  truncate_log(const std::string &file_name, const unsigned int &time_step) {
+    std::ifstream input(file_name);
+    if (!input)
+      return;
+
+    const std::string json_key = "{\"timestep\": ";
+
+    std::vector<std::string> lines;
+      for (std::string line; std::getline(input, line);) {
+        const std::size_t start = line.compare(0, json_key.size(), json_key) == 0 ?
+                                    json_key.size() :
+                                    0;
+        if (start < line.size() && std::isdigit(line[start]) &&
+            std::stoul(line.substr(start)) > time_step)
+          continue;
+
+        lines.push_back(line);
+      }
+    input.close();
+
+    std::ofstream output(file_name, std::ios::trunc);
+    for (const std::string &line : lines)
+      output << line << '\n';
+  }
+
+  // Coefficients a_ij (j <= i) of the L-stable, stiffly accurate SDIRK
+  // schemes of Alexander with 2 and 3 stages. The diagonal ones are all equal
+  // to gamma, and the last stage is the solution of the step.
+  std::vector<std::vector<double>>
+  sdirk_coefficients(const unsigned int &n_stages) {
+      if (n_stages == 2) {
+        const double gamma = 1.0 - std::sqrt(0.5);
+        return {{gamma}, {1.0 - gamma, gamma}};
+      }
+
+    // Root of x^3 - 3 x^2 + 3 x / 2 - 1 / 6 in (1/6, 1/2).
+    const double gamma = 0.43586652150845899942;
+    const double b_1   = -(6.0 * gamma * gamma - 16.0 * gamma + 1.0) / 4.0;
+    const double b_2   = (6.0 * gamma * gamma - 20.0 * gamma + 5.0) / 4.0;
+
+    return {{gamma}, {(1.0 - gamma) / 2.0, gamma}, {b_1, b_2, gamma}};
+  }
+} // namespace
+
+template <int dim, unsigned int degree>
 void
-HeatNonLinear::setup() {
+HeatNonLinear<dim, degree>::setup() {
+  AssertThrow(settings.splitting == HeatNonLinearSettings::Splitting::none ||
+                settings.jacobian_mode == HeatNonLinearSettings::JacobianMode::assembled,
+              ExcMessage("Operator splitting needs the assembled diffusion matrix."));
+  AssertThrow(settings.splitting == HeatNonLinearSettings::Splitting::none ||
+                settings.time_scheme == HeatNonLinearSettings::TimeScheme::backward_euler,
+              ExcMessage("Operator splitting has its own time scheme."));
+  AssertThrow(settings.time_theta >= 0.5 && settings.time_theta <= 1.0,
+              ExcMessage("The theta method is only A-stable for theta in [0.5, 1]."));
+  AssertThrow(settings.front_interval == 0 || r == 1,
+              ExcMessage("The solution is only moved to a new mesh for P1 elements."));
+  AssertThrow(settings.front_interval == 0 || settings.checkpoint_interval == 0,
+              ExcMessage("Checkpoints store the cells of the mesh read by setup(), which "
+                         "the adaptation to the front replaces."));
+
   // Create the mesh.
-  timer_output.enter_subsection("Mesh initialization");
+  enter_section("Mesh initialization");
   {
     pcout << "Initializing the mesh" << std::endl;
-    Triangulation<dim> mesh_serial;
-
-    // GridGenerator::subdivided_hyper_cube(mesh_serial, N + 1, 0.0, 1.0, true);
-    // GridGenerator::convert_hypercube_to_simplex_mesh(mesh_serial, mesh_serial);
-
-    GridIn<dim> grid_in;
-    grid_in.attach_triangulation(mesh_serial);
-    const std::string mesh_file_name = "../mesh/half-brain.msh";
-    std::ifstream     grid_in_file(mesh_file_name);
-    grid_in.read_msh(grid_in_file);
 
-    GridTools::partition_triangulation(mpi_size, mesh_serial);
-    const auto construction_data =
-      TriangulationDescription::Utilities::create_description_from_triangulation(
-        mesh_serial, MPI_COMM_WORLD);
-    mesh.create_triangulation(construction_data);
+    create_mesh();
 
     pcout << "  Number of elements = " << mesh.n_global_active_cells() << std::endl;
+    pcout << "  Threads per process = " << MultithreadInfo::n_threads() << std::endl;
+    if (settings.perf_counters)
+      pcout << "  Hardware counters   = " << section_counters.status() << std::endl;
   }
-  timer_output.leave_subsection("Mesh initialization");
+  leave_section();
 
   pcout << "-----------------------------------------------" << std::endl;
 
@@ -45,8 +192,29 @@ HeatNonLinear::setup() {
 
   pcout << "-----------------------------------------------" << std::endl;
 
+  setup_system();
+}
+
+template <int dim, unsigned int degree>
+void
+HeatNonLinear<dim, degree>::setup_system() {
+  owned_cell_index.assign(mesh.n_active_cells(), numbers::invalid_unsigned_int);
+
+  unsigned int n_owned_cells = 0;
+  for (const auto &cell : mesh.active_cell_iterators())
+    if (cell->is_locally_owned())
+      owned_cell_index[cell->active_cell_index()] = n_owned_cells++;
+
+    if (!settings.fiber_file_name.empty()) {
+      enter_section("Read fiber file");
+      read_fiber_file();
+      leave_section();
+
+      pcout << "-----------------------------------------------" << std::endl;
+    }
+
   // Initialize the DoF handler.
-  timer_output.enter_subsection("Initialize DoFs");
+  enter_section("Initialize DoFs");
   {
     pcout << "Initializing the DoF handler" << std::endl;
 
@@ -58,7 +226,7 @@ HeatNonLinear::setup() {
 
     pcout << "  Number of DoFs = " << dof_handler.n_dofs() << std::endl;
   }
-  timer_output.leave_subsection();
+  leave_section();
 
   pcout << "-----------------------------------------------" << std::endl;
 
@@ -68,48 +236,361 @@ HeatNonLinear::setup() {
 
     pcout << "  Initializing the sparsity pattern" << std::endl;
 
-    TrilinosWrappers::SparsityPattern sparsity(locally_owned_dofs, MPI_COMM_WORLD);
-    DoFTools::make_sparsity_pattern(dof_handler, sparsity);
-    sparsity.compress();
-
-    pcout << "  Initializing the matrices" << std::endl;
-    jacobian_matrix.reinit(sparsity);
+      if (settings.jacobian_mode == HeatNonLinearSettings::JacobianMode::assembled) {
+        TrilinosWrappers::SparsityPattern sparsity(locally_owned_dofs, mpi_comm);
+        DoFTools::make_sparsity_pattern(dof_handler, sparsity);
+        sparsity.compress();
+
+        pcout << "  Initializing the matrices" << std::endl;
+        jacobian_matrix.reinit(sparsity);
+
+          if (use_constant_matrices()) {
+            mass_matrix.reinit(sparsity);
+            stiffness_matrix.reinit(sparsity);
+          }
+      } else {
+        // The Jacobian is never stored: we only need room for the linearized
+        // reaction coefficient at the quadrature nodes of the owned cells.
+        pcout << "  Matrix-free Jacobian, no sparsity pattern needed" << std::endl;
+        reaction_coefficient.resize(mesh.n_locally_owned_active_cells() *
+                                    quadrature->size());
+      }
 
     pcout << "  Initializing the system right-hand side" << std::endl;
-    residual_vector.reinit(locally_owned_dofs, MPI_COMM_WORLD);
+    residual_vector.reinit(locally_owned_dofs, mpi_comm);
     pcout << "  Initializing the solution vector" << std::endl;
-    solution_owned.reinit(locally_owned_dofs, MPI_COMM_WORLD);
-    delta_owned.reinit(locally_owned_dofs, MPI_COMM_WORLD);
-
-    solution.reinit(locally_owned_dofs, locally_relevant_dofs, MPI_COMM_WORLD);
-    solution_old = solution;
+    solution_owned.reinit(locally_owned_dofs, mpi_comm);
+    delta_owned.reinit(locally_owned_dofs, mpi_comm);
+
+    solution.reinit(locally_owned_dofs, locally_relevant_dofs, mpi_comm);
+    solution_old_owned.reinit(locally_owned_dofs, mpi_comm);
+    stage_base = solution;
+    stage_base_owned.reinit(locally_owned_dofs, mpi_comm);
+    stage_deltat = deltat;
   }
+
+    if (settings.cache_geometry) {
+      pcout << "-----------------------------------------------" << std::endl;
+      pcout << "Initializing the geometry cache" << std::endl;
+
+      enter_section("Geometry cache");
+      Timer timer;
+      reinit_geometry_cache();
+      timer.stop();
+      leave_section();
+
+      const double memory = static_cast<double>(geometry_cache.memory_consumption() +
+                                                batch_cache.memory_consumption());
+      const double memory_total = Utilities::MPI::sum(memory, mpi_comm);
+      const double memory_max   = Utilities::MPI::max(memory, mpi_comm);
+
+      // Filling the cache costs about one sweep of FEValues::reinit() over
+      // the owned cells, which is what every assembly saves from now on.
+      pcout << "  Memory (all processes)     = " << memory_total / 1048576.0 << " MB"
+            << std::endl;
+      pcout << "  Memory (max per process)   = " << memory_max / 1048576.0 << " MB"
+            << std::endl;
+      pcout << "  Bytes per cell             = "
+            << memory_total / static_cast<double>(mesh.n_global_active_cells())
+            << std::endl;
+      if (settings.jacobian_mode == HeatNonLinearSettings::JacobianMode::assembled)
+        pcout << "  Jacobian matrix memory     = "
+              << Utilities::MPI::sum(static_cast<double>(
+                                       jacobian_matrix.memory_consumption()),
+                                     mpi_comm) /
+                   1048576.0
+              << " MB" << std::endl;
+      pcout << "  Setup time (saved by each assembly) = "
+            << Utilities::MPI::max(timer.wall_time(), mpi_comm) << " s"
+            << std::endl;
+
+        if (use_batch_kernel())
+          report_assembly_kernels();
+        else if (settings.vectorize_assembly)
+          pcout << "  No batch kernel for this element, using the generic one"
+                << std::endl;
+    }
+
+    if (use_constant_matrices()) {
+      pcout << "-----------------------------------------------" << std::endl;
+
+      enter_section("Assemble constant matrices");
+      assemble_constant_matrices();
+      leave_section();
+    }
+
+    if (settings.diffusivity_cost_report && !settings.fiber_file_name.empty()) {
+      pcout << "-----------------------------------------------" << std::endl;
+      pcout << "Assembly cost of the per-cell diffusivity" << std::endl;
+
+      // The cached kernels read D grad(phi) from the geometry cache, so only
+      // the FEValues kernel pays for the per-cell tensors.
+      const AssemblyKernelTimes times = measure_assembly_kernels();
+
+      pcout << "  FEValues kernel, per-cell D = " << times.fe_values * 1e9 << " ns/cell"
+            << std::endl;
+      pcout << "  FEValues kernel, constant D = " << times.fe_values_constant_D * 1e9
+            << " ns/cell" << std::endl;
+      pcout << "  Overhead                    = "
+            << 100.0 * (times.fe_values / times.fe_values_constant_D - 1.0) << " %"
+            << std::endl;
+    }
+}
+
+template <int dim, unsigned int degree>
+void
+HeatNonLinear<dim, degree>::create_mesh() {
+  const auto read_mesh = [&](Triangulation<dim> &mesh_serial) {
+      if (settings.mesh_file_name.empty()) {
+        // Lines are already simplices.
+          if constexpr (dim == 1) {
+            GridGenerator::subdivided_hyper_cube(mesh_serial, N + 1, 0.0, 1.0, true);
+          } else {
+            Triangulation<dim> mesh_hypercube;
+            GridGenerator::subdivided_hyper_cube(mesh_hypercube, N + 1, 0.0, 1.0, true);
+            GridGenerator::convert_hypercube_to_simplex_mesh(mesh_hypercube, mesh_serial);
+          }
+        return;
+      }
+
+    GridIn<dim> grid_in;
+    grid_in.attach_triangulation(mesh_serial);
+    std::ifstream grid_in_file(settings.mesh_file_name);
+    AssertThrow(grid_in_file,
+                ExcMessage("Cannot open the mesh file " + settings.mesh_file_name));
+    grid_in.read_msh(grid_in_file);
+  };
+
+  // The adaptation to the front refines a copy of the mesh as read.
+  const auto read_original_mesh = [&](Triangulation<dim> &mesh_serial) {
+    read_mesh(mesh_serial);
+    if (settings.front_interval > 0)
+      original_mesh.reinit(mesh_serial);
+  };
+
+  const auto partition_mesh = [&](Triangulation<dim> &mesh_serial,
+                                  const MPI_Comm      comm,
+                                  const unsigned int /*group_size*/) {
+    GridTools::partition_triangulation(Utilities::MPI::n_mpi_processes(comm), mesh_serial);
+  };
+
+  Timer timer;
+
+  TriangulationDescription::Description<dim> construction_data;
+
+    if (!settings.mesh_file_name.empty() && MeshCache::is_cache_file(settings.mesh_file_name)) {
+      // Every process maps the cache, whose pages the processes of a node
+      // share, and describes its part without a serial Triangulation. The
+      // stored partition is used if it has one part per process.
+      SimplexMesh<dim>          mesh_cached;
+      std::vector<unsigned int> partition;
+
+      const unsigned int n_cached_partitions =
+        MeshCache::read(settings.mesh_file_name, mesh_cached, partition);
+      if (n_cached_partitions != mpi_size)
+        partition = mesh_cached.partition(mpi_size, mpi_comm);
+
+      construction_data = mesh_cached.create_description(partition, mpi_comm);
+
+      if (settings.front_interval > 0)
+        original_mesh = std::move(mesh_cached);
+    } else if (settings.mesh_ingestion == HeatNonLinearSettings::MeshIngestion::groups) {
+      unsigned int group_size = settings.mesh_group_size;
+
+        // One group per shared-memory node.
+        if (group_size == 0) {
+          MPI_Comm node_comm;
+          MPI_Comm_split_type(
+            mpi_comm, MPI_COMM_TYPE_SHARED, mpi_rank, MPI_INFO_NULL, &node_comm);
+          group_size = Utilities::MPI::n_mpi_processes(node_comm);
+          MPI_Comm_free(&node_comm);
+        }
+
+      pcout << "  Processes per reader = " << group_size << std::endl;
+
+      // Only the first process of each group reads and partitions the mesh.
+      construction_data =
+        TriangulationDescription::Utilities::create_description_from_triangulation_in_groups<
+          dim,
+          dim>(read_original_mesh, partition_mesh, mpi_comm, group_size);
+
+      // The first process reads in any case.
+      if (settings.front_interval > 0)
+        original_mesh.broadcast(mpi_comm);
+    } else {
+      Triangulation<dim> mesh_serial;
+      read_original_mesh(mesh_serial);
+      partition_mesh(mesh_serial, mpi_comm, 1);
+
+      construction_data =
+        TriangulationDescription::Utilities::create_description_from_triangulation(
+          mesh_serial, mpi_comm);
+    }
+
+  const double read_time = timer.wall_time();
+
+  mesh.create_triangulation(construction_data);
+
+  const double create_time = timer.wall_time() - read_time;
+
+    // The coarse cell ids of the mesh are the indices of the cells of the
+    // mesh read, which is where the adaptation to the front starts from.
+    if (settings.front_interval > 0) {
+      front_mesh = original_mesh;
+      refined_cells.assign(original_mesh.n_cells(), false);
+    }
+
+  // Peak resident memory of each process, which is reached while the mesh is
+  // read.
+  Utilities::System::MemoryStats stats;
+  Utilities::System::get_memory_stats(stats);
+  const double peak_memory = stats.VmHWM / 1024.0;
+
+  pcout << "  Read and partition time (max) = "
+        << Utilities::MPI::max(read_time, mpi_comm) << " s" << std::endl;
+  pcout << "  Distribution time (max)       = "
+        << Utilities::MPI::max(create_time, mpi_comm) << " s" << std::endl;
+  pcout << "  Peak memory (max per process) = "
+        << Utilities::MPI::max(peak_memory, mpi_comm) << " MB" << std::endl;
+  pcout << "  Peak memory (all processes)   = "
+        << Utilities::MPI::sum(peak_memory, mpi_comm) << " MB" << std::endl;
+}
+
+template <int dim, unsigned int degree>
+void
+HeatNonLinear<dim, degree>::set_up_regions() {
+  default_region = {alpha.coefficient, D};
+
+  region_table.clear();
+    for (const auto &[material_id, coefficients] : settings.regions) {
+      if (material_id >= region_table.size())
+        region_table.resize(material_id + 1, default_region);
+
+      region_table[material_id] = {coefficients.alpha,
+                                   set_up_diffusivity(coefficients.d_ext, coefficients.d_axn)};
+    }
+}
+
+template <int dim, unsigned int degree>
+void
+HeatNonLinear<dim, degree>::reinit_geometry_cache() {
+  geometry_cache.reinit(
+    dof_handler,
+    *quadrature,
+    [this](const typename DoFHandler<dim>::active_cell_iterator &cell,
+           const unsigned int                                   &cell_index) {
+      return diffusivity(cell_index, cell->material_id());
+    },
+    [this](const typename DoFHandler<dim>::active_cell_iterator &cell,
+           const FEValues<dim>                                  &fe_values,
+           const unsigned int                                   &q) {
+      return alpha_value(fe_values, q, region(cell->material_id()).alpha);
+    },
+    alpha_flags());
+
+  // The local indices are those of the ghosted vectors, which all share the
+  // layout of solution.
+  if (use_batch_kernel())
+    batch_cache.reinit(geometry_cache, [this](const types::global_dof_index &i) {
+      return static_cast<unsigned int>(solution.trilinos_partitioner().LID(
+        static_cast<TrilinosWrappers::types::int_type>(i)));
+    });
+}
+
+template <int dim, unsigned int degree>
+void
+HeatNonLinear<dim, degree>::read_fiber_file() {
+  pcout << "Reading the fiber orientation from " << settings.fiber_file_name << std::endl;
+
+  // Owned cell indices of the owned parts of every cell of the mesh read by
+  // setup(). The cells start with the diffusivity of their region.
+  std::unordered_map<types::coarse_cell_id, std::vector<unsigned int>> owned_coarse_cells;
+
+  cell_diffusivity.resize(mesh.n_locally_owned_active_cells());
+
+    for (const auto &cell : mesh.active_cell_iterators()) {
+      if (!cell->is_locally_owned())
+        continue;
+
+      const unsigned int c = owned_cell_index[cell->active_cell_index()];
+
+      owned_coarse_cells[original_cell_id(cell)].push_back(c);
+      cell_diffusivity[c] = SymmetricTensor<2, dim>(region(cell->material_id()).D);
+    }
+
+  std::ifstream file(settings.fiber_file_name);
+  AssertThrow(file, ExcMessage("Cannot open the fiber file " + settings.fiber_file_name));
+
+  unsigned int n_read = 0;
+  std::string  line;
+
+    while (std::getline(file, line)) {
+      if (line.empty() || line[0] == '#')
+        continue;
+
+      std::istringstream    fields(line);
+      types::coarse_cell_id id;
+      double                axon_components[3];
+      double                d_ext_cell;
+      double                d_axn_cell;
+
+      fields >> id >> axon_components[0] >> axon_components[1] >> axon_components[2] >>
+        d_ext_cell >> d_axn_cell;
+
+      AssertThrow(fields, ExcMessage("Malformed line in the fiber file: " + line));
+
+      // Lower dimensions use the first components.
+      Tensor<1, dim> axon;
+      for (unsigned int d = 0; d < dim; ++d)
+        axon[d] = axon_components[d];
+
+      const auto owned = owned_coarse_cells.find(id);
+      if (owned == owned_coarse_cells.end())
+        continue;
+
+      if (axon.norm() > 0)
+        axon /= axon.norm();
+
+        for (const unsigned int c : owned->second) {
+          cell_diffusivity[c] = d_ext_cell * unit_symmetric_tensor<dim>() +
+                                d_axn_cell * symmetrize(outer_product(axon, axon));
+          ++n_read;
+        }
+    }
+
+  // Per-cell storage replaces a single tensor, which is what the constant
+  // diffusivity costs.
+  const double memory =
+    static_cast<double>(MemoryConsumption::memory_consumption(cell_diffusivity));
+
+  pcout << "  Cells with a local orientation = " << Utilities::MPI::sum(n_read, mpi_comm)
+        << std::endl;
+  pcout << "  Memory (all processes)         = "
+        << Utilities::MPI::sum(memory, mpi_comm) / 1048576.0 << " MB" << std::endl;
+  pcout << "  Memory (max per process)       = "
+        << Utilities::MPI::max(memory, mpi_comm) / 1048576.0 << " MB (constant: "
+        << sizeof(D) << " bytes)" << std::endl;
 }
 
+template <int dim, unsigned int degree>
 void
-HeatNonLinear::assemble_system() {
+HeatNonLinear<dim, degree>::assemble_constant_matrices() {
+  pcout << "Assembling the mass and stiffness matrices" << std::endl;
+
   const unsigned int dofs_per_cell = fe->dofs_per_cell;
   const unsigned int n_q           = quadrature->size();
 
   FEValues<dim> fe_values(*fe,
                           *quadrature,
-                          update_values | update_gradients | update_quadrature_points |
-                            update_JxW_values);
+                          update_values | update_gradients | update_JxW_values);
 
-  FullMatrix<double> cell_matrix(dofs_per_cell, dofs_per_cell);
-  Vector<double>     cell_residual(dofs_per_cell);
+  FullMatrix<double> cell_mass_matrix(dofs_per_cell, dofs_per_cell);
+  FullMatrix<double> cell_stiffness_matrix(dofs_per_cell, dofs_per_cell);
 
   std::vector<types::global_dof_index> dof_indices(dofs_per_cell);
 
-  jacobian_matrix = 0.0;
-  residual_vector = 0.0;
-
-  // Value and gradient of the solution on current cell.
-  std::vector<double>         solution_loc(n_q);
-  std::vector<Tensor<1, dim>> solution_gradient_loc(n_q);
-
-  // Value of the solution at previous timestep (un) on current cell.
-  std::vector<double> solution_old_loc(n_q);
+  mass_matrix      = 0.0;
+  stiffness_matrix = 0.0;
 
     for (const auto &cell : dof_handler.active_cell_iterators()) {
       if (!cell->is_locally_owned())
@@ -117,219 +598,2412 @@ HeatNonLinear::assemble_system() {
 
       fe_values.reinit(cell);
 
-      cell_matrix   = 0.0;
-      cell_residual = 0.0;
+      const Tensor<2, dim> D_cell =
+        diffusivity(owned_cell_index[cell->active_cell_index()], cell->material_id());
 
-      fe_values.get_function_values(solution, solution_loc);             // u n+1
-      fe_values.get_function_gradients(solution, solution_gradient_loc); // grad u n+1
-      fe_values.get_function_values(solution_old, solution_old_loc);     // u n
+      cell_mass_matrix      = 0.0;
+      cell_stiffness_matrix = 0.0;
 
         for (unsigned int q = 0; q < n_q; ++q) {
-          // Evaluate coefficients on this quadrature node.
-          const double alpha_loc = alpha.value(fe_values.quadrature_point(q));
-
             for (unsigned int i = 0; i < dofs_per_cell; ++i) {
                 for (unsigned int j = 0; j < dofs_per_cell; ++j) {
-                  // ------------------------------------------- (A.1)
-                  // ------------------------------------------- // Mass matrix.
-                  cell_matrix(i, j) += fe_values.shape_value(i, q) *
-                                       fe_values.shape_value(j, q) / deltat *
-                                       fe_values.JxW(q);
-
-                  // ------------------------------------------- (A.2)
-                  // ------------------------------------------- // Non-linear stiffness
-                  // matrix, first term.
-                  cell_matrix(i, j) += fe_values.shape_grad(i, q) * D *
-                                       fe_values.shape_grad(j, q) * fe_values.JxW(q);
+                  cell_mass_matrix(i, j) += fe_values.shape_value(i, q) *
+                                            fe_values.shape_value(j, q) * fe_values.JxW(q);
 
-                  // ------------------------------------------- (A.3)
-                  // ------------------------------------------- // Non-linear stiffness
-                  // matrix, second term.
-                  cell_matrix(i, j) -= fe_values.shape_value(i, q) * alpha_loc *
-                                       (1 - 2 * solution_loc[q]) *
-                                       fe_values.shape_value(j, q) * fe_values.JxW(q);
+                  cell_stiffness_matrix(i, j) += fe_values.shape_grad(i, q) * D_cell *
+                                                 fe_values.shape_grad(j, q) *
+                                                 fe_values.JxW(q);
                 }
+            }
+        }
 
-              // Assemble the residual vector (with changed sign).
+      cell->get_dof_indices(dof_indices);
 
-              // ------------------------------------------- (R.1)
-              // ------------------------------------------- // Time derivative term.
-              cell_residual(i) -= fe_values.shape_value(i, q) *
-                                  (solution_loc[q] - solution_old_loc[q]) / deltat *
-                                  fe_values.JxW(q);
+      mass_matrix.add(dof_indices, cell_mass_matrix);
+      stiffness_matrix.add(dof_indices, cell_stiffness_matrix);
+    }
 
-              // ------------------------------------------- (R.2)
-              // ------------------------------------------- //
-              cell_residual(i) -= fe_values.shape_grad(i, q) * D *
-                                  solution_gradient_loc[q] * fe_values.JxW(q);
+  mass_matrix.compress(VectorOperation::add);
+  stiffness_matrix.compress(VectorOperation::add);
 
-              // ------------------------------------------- (R.3)
-              // ------------------------------------------- // Diffusion term.
-              cell_residual(i) += fe_values.shape_value(i, q) *
-                                  (alpha_loc * solution_loc[q] * (1 - solution_loc[q])) *
-                                  fe_values.JxW(q);
+    if (settings.assembly == HeatNonLinearSettings::Assembly::precomputed_lumped) {
+      // Row sums of M are only positive for P1 on simplices.
+      AssertThrow(r == 1,
+                  ExcMessage("The lumped reaction term is only available for P1 elements."));
+
+      TrilinosWrappers::MPI::Vector ones(locally_owned_dofs, mpi_comm);
+      ones = 1.0;
+
+      lumped_mass.reinit(locally_owned_dofs, mpi_comm);
+      mass_matrix.vmult(lumped_mass, ones);
+    }
+
+    if (settings.assembly == HeatNonLinearSettings::Assembly::precomputed_lumped ||
+        settings.splitting == HeatNonLinearSettings::Splitting::strang) {
+      alpha_nodal.reinit(locally_owned_dofs, mpi_comm);
+
+        if (settings.spatial_alpha) {
+          VectorTools::interpolate(dof_handler, alpha, alpha_nodal);
+        } else {
+          // Nodes on the interface of two regions take the coefficient of
+          // either of them.
+          std::vector<types::global_dof_index> dof_indices(fe->dofs_per_cell);
+
+            for (const auto &cell : dof_handler.active_cell_iterators()) {
+              if (!cell->is_locally_owned())
+                continue;
+
+              cell->get_dof_indices(dof_indices);
+              for (const auto i : dof_indices)
+                if (locally_owned_dofs.is_element(i))
+                  alpha_nodal[i] = region(cell->material_id()).alpha;
             }
+
+          alpha_nodal.compress(VectorOperation::insert);
         }
+    }
+}
 
-      cell->get_dof_indices(dof_indices);
+template <int dim, unsigned int degree>
+void
+HeatNonLinear<dim, degree>::assemble_reaction_system(const bool &assemble_jacobian) {
+  residual_vector = 0.0;
+
+    if (settings.assembly == HeatNonLinearSettings::Assembly::precomputed) {
+      // Only the reaction term depends on the solution, so it is the only one
+      // integrated here. Its Jacobian contribution is stored with changed sign.
+      const unsigned int dofs_per_cell = fe->dofs_per_cell;
+      const unsigned int n_q           = quadrature->size();
+
+      const auto local_assemble = [&](const typename DoFHandler<dim>::active_cell_iterator &cell,
+                                      AssemblyScratchData &scratch_data,
+                                      AssemblyCopyData    &copy_data) {
+        FEValues<dim>      &fe_values     = scratch_data.fe_values;
+        FullMatrix<double> &cell_matrix   = copy_data.cell_matrix;
+        Vector<double>     &cell_residual = copy_data.cell_residual;
+
+        fe_values.reinit(cell);
+
+        cell_matrix   = 0.0;
+        cell_residual = 0.0;
 
-      jacobian_matrix.add(dof_indices, cell_matrix);
-      residual_vector.add(dof_indices, cell_residual);
+        fe_values.get_function_values(solution, scratch_data.solution_loc);
+
+        const double region_alpha = region(cell->material_id()).alpha;
+
+          for (unsigned int q = 0; q < n_q; ++q) {
+            const double u_loc     = scratch_data.solution_loc[q];
+            const double alpha_loc = alpha_value(fe_values, q, region_alpha);
+
+            const double reaction_loc = alpha_loc * (1 - 2 * u_loc) * fe_values.JxW(q);
+            const double source_loc   = alpha_loc * u_loc * (1 - u_loc) * fe_values.JxW(q);
+
+              for (unsigned int i = 0; i < dofs_per_cell; ++i) {
+                const double phi_i = fe_values.shape_value(i, q);
+
+                if (assemble_jacobian)
+                  for (unsigned int j = 0; j < dofs_per_cell; ++j)
+                    cell_matrix(i, j) -= phi_i * reaction_loc * fe_values.shape_value(j, q);
+
+                cell_residual(i) += phi_i * source_loc;
+              }
+          }
+
+        cell->get_dof_indices(copy_data.dof_indices);
+      };
+
+      const auto copy_local_to_global = [&](const AssemblyCopyData &copy_data) {
+        if (assemble_jacobian)
+          jacobian_matrix.add(copy_data.dof_indices, copy_data.cell_matrix);
+        residual_vector.add(copy_data.dof_indices, copy_data.cell_residual);
+      };
+
+      if (assemble_jacobian)
+        jacobian_matrix = 0.0;
+
+      // Threads as in assemble_system().
+      using CellFilter = FilteredIterator<typename DoFHandler<dim>::active_cell_iterator>;
+
+      WorkStream::run(
+        CellFilter(IteratorFilters::LocallyOwnedCell(), dof_handler.begin_active()),
+        CellFilter(IteratorFilters::LocallyOwnedCell(), dof_handler.end()),
+        local_assemble,
+        copy_local_to_global,
+        AssemblyScratchData(*fe, *quadrature, alpha_flags(), assemble_jacobian, false, false),
+        AssemblyCopyData(dofs_per_cell));
+
+      residual_vector.compress(VectorOperation::add);
+
+        if (assemble_jacobian) {
+          jacobian_matrix.compress(VectorOperation::add);
+          jacobian_matrix.add(1.0, stiffness_matrix);
+          jacobian_matrix.add(1.0 / stage_deltat, mass_matrix);
+        }
+    } else {
+      // Group formulation: the reaction term is interpolated at the nodes and
+      // integrated with the lumped mass matrix, so that it only adds to the
+      // diagonal and no quadrature loop is needed.
+      const double *u = solution_owned.begin();
+      const double *m = lumped_mass.begin();
+      const double *a = alpha_nodal.begin();
+      double       *f = residual_vector.begin();
+
+      parallel::apply_to_subranges(
+        0u,
+        locally_owned_dofs.n_elements(),
+        [&](const unsigned int &begin, const unsigned int &end) {
+          for (unsigned int k = begin; k < end; ++k)
+            f[k] = m[k] * a[k] * u[k] * (1 - u[k]);
+        },
+        nodal_grain_size);
+
+        if (assemble_jacobian) {
+          jacobian_matrix = 0.0;
+          jacobian_matrix.add(1.0, stiffness_matrix);
+          jacobian_matrix.add(1.0 / stage_deltat, mass_matrix);
+
+          unsigned int k = 0;
+            for (const auto i : locally_owned_dofs) {
+              jacobian_matrix.add(i, i, -m[k] * a[k] * (1 - 2 * u[k]));
+              ++k;
+            }
+
+          jacobian_matrix.compress(VectorOperation::add);
+        }
     }
 
-  jacobian_matrix.compress(VectorOperation::add);
-  residual_vector.compress(VectorOperation::add);
+  // Time derivative and diffusion terms, as products with the constant
+  // matrices (residual with changed sign).
+  TrilinosWrappers::MPI::Vector increment(solution_owned);
+  TrilinosWrappers::MPI::Vector tmp(locally_owned_dofs, mpi_comm);
 
-  // We apply Dirichlet boundary conditions.
-  // The linear system solution is delta, which is the difference between
-  // u_{n+1}^{(k+1)} and u_{n+1}^{(k)}. Both must satisfy the same Dirichlet
-  // boundary conditions: therefore, on the boundary, delta = u_{n+1}^{(k+1)} -
-  // u_{n+1}^{(k+1)} = 0. We impose homogeneous Dirichlet BCs.
-  // {
-  //   std::map<types::global_dof_index, double> boundary_values;
+  increment -= stage_base_owned;
 
-  //   std::map<types::boundary_id, const Function<dim> *> boundary_functions;
-  //   Functions::ZeroFunction<dim>                        zero_function;
+  mass_matrix.vmult(tmp, increment);
+  residual_vector.add(-1.0 / stage_deltat, tmp);
 
-  //   for (unsigned int i = 0; i < 6; ++i)
-  //     boundary_functions[i] = &zero_function;
+  stiffness_matrix.vmult(tmp, solution_owned);
+  residual_vector -= tmp;
+}
 
-  //   VectorTools::interpolate_boundary_values(dof_handler,
-  //                                            boundary_functions,
-  //                                            boundary_values);
+template <int dim, unsigned int degree>
+HeatNonLinear<dim, degree>::AssemblyScratchData::AssemblyScratchData(
+  const FiniteElement<dim> &fe,
+  const Quadrature<dim>    &quadrature,
+  const UpdateFlags        &alpha_flags,
+  const bool               &assemble_matrix_,
+  const bool               &assemble_operator_,
+  const bool               &gradients) :
+  fe_values(fe,
+            quadrature,
+            update_values | update_JxW_values | alpha_flags |
+              (gradients ? update_gradients : update_default)),
+  assemble_matrix(assemble_matrix_), assemble_operator(assemble_operator_),
+  solution_dofs(fe.dofs_per_cell), base_dofs(fe.dofs_per_cell),
+  solution_loc(quadrature.size()), solution_gradient_loc(quadrature.size()),
+  base_loc(quadrature.size()) {}
+
+template <int dim, unsigned int degree>
+HeatNonLinear<dim, degree>::AssemblyScratchData::AssemblyScratchData(
+  const AssemblyScratchData &scratch_data) :
+  fe_values(scratch_data.fe_values.get_fe(),
+            scratch_data.fe_values.get_quadrature(),
+            scratch_data.fe_values.get_update_flags()),
+  assemble_matrix(scratch_data.assemble_matrix),
+  assemble_operator(scratch_data.assemble_operator),
+  solution_dofs(scratch_data.solution_dofs),
+  base_dofs(scratch_data.base_dofs),
+  solution_loc(scratch_data.solution_loc),
+  solution_gradient_loc(scratch_data.solution_gradient_loc),
+  base_loc(scratch_data.base_loc) {}
+
+template <int dim, unsigned int degree>
+HeatNonLinear<dim, degree>::AssemblyCopyData::AssemblyCopyData(
+  const unsigned int &dofs_per_cell) :
+  cell_matrix(dofs_per_cell, dofs_per_cell), cell_residual(dofs_per_cell),
+  cell_diagonal(dofs_per_cell), dof_indices(dofs_per_cell) {}
+
+template <int dim, unsigned int degree>
+HeatNonLinear<dim, degree>::AssemblyBatchCopyData::AssemblyBatchCopyData(
+  const unsigned int &dofs_per_cell) :
+  cells(VectorizedArray<double>::size(), AssemblyCopyData(dofs_per_cell)) {}
+
+template <int dim, unsigned int degree>
+bool
+HeatNonLinear<dim, degree>::use_batch_kernel() const {
+  if (!settings.cache_geometry || !settings.vectorize_assembly)
+    return false;
+
+  // Must match the kernel instantiated in local_assemble_batch().
+  return batch_max_n_q > 0 && geometry_cache.dofs_per_cell() == n_dofs_per_cell &&
+         geometry_cache.n_q_points() <= batch_max_n_q;
+}
 
-  //   MatrixTools::apply_boundary_values(
-  //     boundary_values, jacobian_matrix, delta_owned, residual_vector, false);
-  // }
+template <int dim, unsigned int degree>
+void
+HeatNonLinear<dim, degree>::local_assemble_batch(const unsigned int    &first_cell,
+                                                 AssemblyScratchData   &scratch_data,
+                                                 AssemblyBatchCopyData &copy_data) {
+  if constexpr (batch_max_n_q > 0)
+    local_assemble_batch_kernel<n_dofs_per_cell, batch_max_n_q>(first_cell,
+                                                                scratch_data,
+                                                                copy_data);
+  else
+    Assert(false, ExcMessage("No batch kernel for this degree."));
 }
 
-// TODO CHOOSE THE BETTER PRECONDITIONER
+template <int dim, unsigned int degree>
+template <unsigned int n_dofs, unsigned int max_n_q>
 void
-HeatNonLinear::solve_linear_system() {
-  SolverControl solver_control(1000, 1e-6 * residual_vector.l2_norm());
+HeatNonLinear<dim, degree>::local_assemble_batch_kernel(const unsigned int    &first_cell,
+                                                        AssemblyScratchData   &scratch_data,
+                                                        AssemblyBatchCopyData &copy_data) {
+  using VA = VectorizedArray<double>;
+
+  constexpr unsigned int n_lanes = VA::size();
+
+  const unsigned int n_q = batch_cache.n_q_points();
+  Assert(n_q <= max_n_q, ExcInternalError());
+
+  const unsigned int batch    = first_cell / n_lanes;
+  const unsigned int n_filled = batch_cache.n_filled(batch);
+  copy_data.n_filled          = n_filled;
+
+  // Shape function values are the same on every cell.
+  double phi[max_n_q][n_dofs];
+  for (unsigned int q = 0; q < n_q; ++q)
+    for (unsigned int i = 0; i < n_dofs; ++i)
+      phi[q][i] = geometry_cache.shape_value(i, q);
+
+  // DoF values of u n+1 and of the stage base w, one cell per lane, gathered
+  // from the local storage of the ghosted vectors.
+  const unsigned int *local_indices = batch_cache.local_dof_indices(batch);
+  const double       *solution_data = solution.trilinos_vector()[0];
+  const double       *base_data     = stage_base.trilinos_vector()[0];
+
+  VA solution_dofs[n_dofs];
+  VA base_dofs[n_dofs];
+
+    for (unsigned int i = 0; i < n_dofs; ++i) {
+      solution_dofs[i].gather(solution_data, local_indices + i * n_lanes);
+      base_dofs[i].gather(base_data, local_indices + i * n_lanes);
+    }
 
-  SolverCG<TrilinosWrappers::MPI::Vector> solver(solver_control);
-  // SolverGMRES<TrilinosWrappers::MPI::Vector> solver(solver_control);
-  TrilinosWrappers::PreconditionSSOR preconditioner;
-  preconditioner.initialize(jacobian_matrix,
-                            TrilinosWrappers::PreconditionSSOR::AdditionalData(1.0));
+  VA cell_matrix[n_dofs][n_dofs];
+  VA cell_residual[n_dofs];
+  VA cell_diagonal[n_dofs];
 
-  solver.solve(jacobian_matrix, delta_owned, residual_vector, preconditioner);
-  pcout << "  " << solver_control.last_step() << " CG iterations" << std::endl;
-  // pcout << "  " << solver_control.last_step() << " GMRES iterations" << std::endl;
-}
+    for (unsigned int i = 0; i < n_dofs; ++i) {
+      for (unsigned int j = 0; j < n_dofs; ++j)
+        cell_matrix[i][j] = 0.0;
 
-void
-HeatNonLinear::solve_newton() {
-  const unsigned int n_max_iters        = 1000;
-  const double       residual_tolerance = 1e-10;
+      cell_residual[i] = 0.0;
+      cell_diagonal[i] = 0.0;
+    }
 
-  unsigned int n_iter        = 0;
-  double       residual_norm = residual_tolerance + 1;
+  const double inv_deltat = 1.0 / stage_deltat;
 
-  // We apply the boundary conditions to the initial guess (which is stored in
-  // solution_owned and solution).
-  {
-    //?????
-  }
+  const VA                 *JxW_batch    = batch_cache.JxW(batch);
+  const VA                 *alpha_batch  = batch_cache.alpha(batch);
+  const Tensor<1, dim, VA> *grad_batch   = batch_cache.shape_gradients(batch);
+  const Tensor<1, dim, VA> *D_grad_batch = batch_cache.D_shape_gradients(batch);
 
-    while (n_iter < n_max_iters && residual_norm > residual_tolerance) {
-      timer_output.enter_subsection("Assemble system");
-      assemble_system();
-      timer_output.leave_subsection();
-      residual_norm = residual_vector.l2_norm();
+    for (unsigned int q = 0; q < n_q; ++q) {
+      const VA                 &JxW       = JxW_batch[q];
+      const VA                 &alpha_loc = alpha_batch[q];
+      const Tensor<1, dim, VA> *grad_phi  = grad_batch + q * n_dofs;
+      const Tensor<1, dim, VA> *D_grad    = D_grad_batch + q * n_dofs;
 
-      pcout << "  Newton iteration " << n_iter << "/" << n_max_iters
-            << " - ||r|| = " << std::scientific << std::setprecision(6) << residual_norm
-            << std::flush;
+      VA                 solution_loc = 0.0;
+      VA                 base_loc     = 0.0;
+      Tensor<1, dim, VA> solution_gradient_loc;
 
-        // We actually solve the system only if the residual is larger than the
-        // tolerance.
-        if (residual_norm > residual_tolerance) {
-          timer_output.enter_subsection("Solve linear system");
-          solve_linear_system();
-          timer_output.leave_subsection();
+        for (unsigned int i = 0; i < n_dofs; ++i) {
+          solution_loc += phi[q][i] * solution_dofs[i];
+          base_loc += phi[q][i] * base_dofs[i];
+          solution_gradient_loc += solution_dofs[i] * grad_phi[i];
+        }
 
-          solution_owned += delta_owned;
-          solution = solution_owned;
-        } else {
-          pcout << " < tolerance" << std::endl;
+      // Same coefficients as in local_assemble_system_cached().
+      const VA reaction_loc      = alpha_loc * (1.0 - 2.0 * solution_loc);
+      const VA value_coefficient = (inv_deltat - reaction_loc) * JxW;
+      const VA value_residual =
+        ((solution_loc - base_loc) * inv_deltat -
+         alpha_loc * solution_loc * (1.0 - solution_loc)) *
+        JxW;
+
+      if (scratch_data.assemble_operator)
+        for (unsigned int v = 0; v < n_filled; ++v)
+          reaction_coefficient[(first_cell + v) * n_q + q] = reaction_loc[v];
+
+        for (unsigned int i = 0; i < n_dofs; ++i) {
+          const Tensor<1, dim, VA> D_grad_JxW = D_grad[i] * JxW;
+
+          if (scratch_data.assemble_matrix)
+            for (unsigned int j = 0; j < n_dofs; ++j)
+              cell_matrix[i][j] +=
+                phi[q][i] * phi[q][j] * value_coefficient + D_grad_JxW * grad_phi[j];
+
+          if (scratch_data.assemble_operator)
+            cell_diagonal[i] +=
+              phi[q][i] * phi[q][i] * value_coefficient + D_grad_JxW * grad_phi[i];
+
+          cell_residual[i] -= phi[q][i] * value_residual + D_grad_JxW * solution_gradient_loc;
         }
+    }
 
-      ++n_iter;
+    for (unsigned int v = 0; v < n_filled; ++v) {
+      AssemblyCopyData              &cell_data = copy_data.cells[v];
+      const types::global_dof_index *indices   = geometry_cache.dof_indices(first_cell + v);
+
+        for (unsigned int i = 0; i < n_dofs; ++i) {
+          cell_data.dof_indices[i]   = indices[i];
+          cell_data.cell_residual(i) = cell_residual[i][v];
+
+          if (scratch_data.assemble_matrix)
+            for (unsigned int j = 0; j < n_dofs; ++j)
+              cell_data.cell_matrix(i, j) = cell_matrix[i][j][v];
+
+          if (scratch_data.assemble_operator)
+            cell_data.cell_diagonal(i) = cell_diagonal[i][v];
+        }
+    }
+}
+
+template <int dim, unsigned int degree>
+typename HeatNonLinear<dim, degree>::AssemblyKernelTimes
+HeatNonLinear<dim, degree>::measure_assembly_kernels(const unsigned int &n_sweeps) {
+  const bool matrix_free =
+    (settings.jacobian_mode == HeatNonLinearSettings::JacobianMode::matrix_free);
+  const unsigned int n_lanes = VectorizedArray<double>::size();
+
+  // The kernels only write to their copy data (and to the reaction
+  // coefficient in matrix-free mode, which the next assembly overwrites).
+  AssemblyScratchData   scratch_data(*fe, *quadrature, alpha_flags(), !matrix_free, matrix_free);
+  AssemblyCopyData      copy_data(fe->dofs_per_cell);
+  AssemblyBatchCopyData batch_copy_data(fe->dofs_per_cell);
+
+  // Fastest of n_sweeps sweeps of the given kernel over the owned cells.
+  const auto time_kernel = [&](const auto &sweep) {
+    double best_time = std::numeric_limits<double>::max();
+
+      for (unsigned int k = 0; k < std::max(n_sweeps, 1u); ++k) {
+        Timer timer;
+        sweep();
+        timer.stop();
+        best_time = std::min(best_time, timer.wall_time());
+      }
+
+    // The slowest process sets the pace of the assembly.
+    return Utilities::MPI::max(best_time, mpi_comm) * mpi_size /
+           static_cast<double>(mesh.n_global_active_cells());
+  };
+
+  AssemblyKernelTimes times;
+
+  times.fe_values = time_kernel([&]() {
+    for (const auto &cell : dof_handler.active_cell_iterators())
+      if (cell->is_locally_owned())
+        local_assemble_system(cell, scratch_data, copy_data);
+  });
+
+    if (!cell_diffusivity.empty()) {
+      // Without the per-cell tensors, diffusivity() falls back to the regions.
+      std::vector<SymmetricTensor<2, dim>> fibers;
+      fibers.swap(cell_diffusivity);
+
+      times.fe_values_constant_D = time_kernel([&]() {
+        for (const auto &cell : dof_handler.active_cell_iterators())
+          if (cell->is_locally_owned())
+            local_assemble_system(cell, scratch_data, copy_data);
+      });
+
+      fibers.swap(cell_diffusivity);
+    }
+
+    if (settings.cache_geometry) {
+      times.cached = time_kernel([&]() {
+        for (const auto &cell : dof_handler.active_cell_iterators())
+          if (cell->is_locally_owned())
+            local_assemble_system_cached(cell, scratch_data, copy_data);
+      });
+    }
+
+    if (use_batch_kernel()) {
+      times.batch = time_kernel([&]() {
+        for (unsigned int c = 0; c < geometry_cache.n_cells(); c += n_lanes)
+          local_assemble_batch(c, scratch_data, batch_copy_data);
+      });
     }
+
+  return times;
 }
 
+template <int dim, unsigned int degree>
 void
-HeatNonLinear::output(const unsigned int &time_step, const double &time) const {
-  DataOut<dim> data_out;
-  data_out.add_data_vector(dof_handler, solution, "u");
+HeatNonLinear<dim, degree>::report_assembly_kernels() {
+  const AssemblyKernelTimes times = measure_assembly_kernels();
+
+  pcout << "  SIMD lanes                 = " << VectorizedArray<double>::size() << std::endl;
+  pcout << "  FEValues kernel            = " << times.fe_values * 1e9 << " ns/cell"
+        << std::endl;
+  pcout << "  Generic kernel             = " << times.cached * 1e9 << " ns/cell"
+        << std::endl;
+  pcout << "  Batch kernel               = " << times.batch * 1e9 << " ns/cell"
+        << std::endl;
+  pcout << "  Speed-up                   = " << times.cached / times.batch << std::endl;
+}
 
-  // std::vector<unsigned int> partition_int(mesh.n_active_cells());
-  // GridTools::get_subdomain_association(mesh, partition_int);
-  // const Vector<double> partitioning(partition_int.begin(), partition_int.end());
-  // data_out.add_data_vector(partitioning, "partitioning");
+template <int dim, unsigned int degree>
+std::map<std::string, Utilities::MPI::MinMaxAvg>
+HeatNonLinear<dim, degree>::section_times() const {
+  // Every process enters the same sections, so the maps have the same keys.
+  const std::map<std::string, double> local_times =
+    timer_output.get_summary_data(TimerOutput::total_wall_time);
 
-  data_out.build_patches();
+  std::vector<double> values;
+  for (const auto &[section, wall_time] : local_times)
+    values.push_back(wall_time);
 
-  std::string output_file_name = std::to_string(time_step);
+  const std::vector<Utilities::MPI::MinMaxAvg> statistics =
+    Utilities::MPI::min_max_avg(values, mpi_comm);
 
-  // Pad with zeros.
-  output_file_name =
-    "output-" + std::string(4 - output_file_name.size(), '0') + output_file_name;
+  std::map<std::string, Utilities::MPI::MinMaxAvg> result;
+  unsigned int                                     k = 0;
+  for (const auto &[section, wall_time] : local_times)
+    result[section] = statistics[k++];
 
-  DataOutBase::DataOutFilter data_filter(
-    DataOutBase::DataOutFilterFlags(/*filter_duplicate_vertices = */ false,
-                                    /*xdmf_hdf5_output = */ true));
-  data_out.write_filtered_data(data_filter);
-  data_out.write_hdf5_parallel(data_filter, output_file_name + ".h5", MPI_COMM_WORLD);
+  return result;
+}
 
-  std::vector<XDMFEntry> xdmf_entries({data_out.create_xdmf_entry(
-    data_filter, output_file_name + ".h5", time, MPI_COMM_WORLD)});
-  data_out.write_xdmf_file(xdmf_entries, output_file_name + ".xdmf", MPI_COMM_WORLD);
+template <int dim, unsigned int degree>
+void
+HeatNonLinear<dim, degree>::report_load_balance(const std::string &file_name) const {
+  // The partitioner finds the processes owning our ghost DoFs (ghost
+  // targets) and those having our owned DoFs as ghosts (import targets),
+  // which are the partners of every ghost update.
+  const Utilities::MPI::Partitioner partitioner(locally_owned_dofs,
+                                                locally_relevant_dofs,
+                                                mpi_comm);
+
+  std::set<unsigned int> neighbors;
+  for (const auto &target : partitioner.ghost_targets())
+    neighbors.insert(target.first);
+  for (const auto &target : partitioner.import_targets())
+    neighbors.insert(target.first);
+
+  // Name in the report and in the CSV file, and value on this process.
+  const std::vector<std::tuple<std::string, std::string, double>> quantities = {
+    {"Owned cells", "owned_cells", mesh.n_locally_owned_active_cells()},
+    {"Owned DoFs", "owned_dofs", locally_owned_dofs.n_elements()},
+    {"Ghost DoFs", "ghost_dofs", partitioner.n_ghost_indices()},
+    {"Neighbor processes", "neighbors", neighbors.size()},
+    {"Bytes sent per update", "bytes_sent", partitioner.n_import_indices() * sizeof(double)},
+    {"Bytes received per update",
+     "bytes_received",
+     partitioner.n_ghost_indices() * sizeof(double)},
+    {"Ghost update time", "ghost_update_time", ghost_update_time}};
+
+  std::vector<double> values;
+  for (const auto &quantity : quantities)
+    values.push_back(std::get<2>(quantity));
+
+  const std::vector<Utilities::MPI::MinMaxAvg> statistics =
+    Utilities::MPI::min_max_avg(values, mpi_comm);
+  const std::map<std::string, Utilities::MPI::MinMaxAvg> sections = section_times();
+
+  // Columns: minimum, average, maximum, rank of the maximum, and the ratio of
+  // the maximum to the average, which is 1 for a perfect balance.
+  const auto print_row = [this](const std::string &name, const auto &...columns) {
+    pcout << "  " << std::left << std::setw(28) << name << std::right;
+    ((pcout << std::setw(12) << columns), ...);
+    pcout << std::endl;
+  };
+
+  const auto print_statistics = [&](const std::string               &name,
+                                    const Utilities::MPI::MinMaxAvg &value) {
+    const double ratio = (value.avg > 0.0) ? value.max / value.avg : 1.0;
+    print_row(name, value.min, value.avg, value.max, value.max_index, ratio);
+  };
+
+  pcout << "===============================================" << std::endl;
+  pcout << "Load balance over " << mpi_size << " processes" << std::endl;
+  pcout << std::defaultfloat << std::setprecision(6);
+
+  print_row("", "min", "avg", "max", "rank", "max/avg");
+  for (unsigned int k = 0; k < quantities.size(); ++k)
+    print_statistics(std::get<0>(quantities[k]), statistics[k]);
+
+  pcout << "  Ghost updates per process = " << n_ghost_updates << std::endl;
+  pcout << "Wall time per section (s)" << std::endl;
+
+  for (const auto &[section, time] : sections)
+    print_statistics(section, time);
+
+  if (file_name.empty())
+    return;
+
+  // One row per process: the quantities, then the time of every section.
+  const std::map<std::string, double> local_sections =
+    timer_output.get_summary_data(TimerOutput::total_wall_time);
+
+  std::vector<double> row = values;
+  row.push_back(static_cast<double>(n_ghost_updates));
+  for (const auto &[section, time] : local_sections)
+    row.push_back(time);
+
+  const std::vector<std::vector<double>> rows = Utilities::MPI::gather(mpi_comm, row, 0);
+
+    if (mpi_rank == 0) {
+      std::ofstream file(file_name);
+      AssertThrow(file, ExcMessage("Cannot open the load balance file " + file_name));
+
+      file << "rank";
+      for (const auto &quantity : quantities)
+        file << "," << std::get<1>(quantity);
+      file << ",ghost_updates";
+      for (const auto &[section, time] : local_sections)
+        file << "," << section;
+      file << std::endl;
+
+        for (unsigned int rank = 0; rank < rows.size(); ++rank) {
+          file << std::setprecision(12) << rank;
+          for (const double &value : rows[rank])
+            file << "," << value;
+          file << std::endl;
+        }
+    }
 }
 
+template <int dim, unsigned int degree>
 void
-HeatNonLinear::solve() {
+HeatNonLinear<dim, degree>::report_hardware_counters() const {
+  // The counters may be missing on some processes only.
+  const unsigned int n_available =
+    Utilities::MPI::sum(section_counters.available() ? 1u : 0u, mpi_comm);
+  const bool count_flops =
+    Utilities::MPI::min(section_counters.counts(PerfCounters::flops) ? 1u : 0u, mpi_comm) > 0;
+
   pcout << "===============================================" << std::endl;
 
-  time = 0.0;
+    if (n_available < mpi_size) {
+      pcout << "Hardware counters not available on " << mpi_size - n_available << " of "
+            << mpi_size << " processes (first process: " << section_counters.status() << ")"
+            << std::endl;
+      return;
+    }
 
-  // Apply the initial condition.
-  {
-    pcout << "Applying the initial condition" << std::endl;
+  // Every process enters the same sections, so the timer gives them in the
+  // same order everywhere. The counts of each section, then its number of
+  // calls, are summed over the processes.
+  const std::map<std::string, Utilities::MPI::MinMaxAvg> times = section_times();
 
-    VectorTools::interpolate(dof_handler, u_0, solution_owned);
-    solution = solution_owned;
+  std::vector<double> values;
+    for (const auto &[section, time] : times) {
+      const auto counts = section_counters.sections().find(section);
+      const bool found  = (counts != section_counters.sections().end());
 
-    // Output the initial solution.
-    timer_output.enter_subsection("Writing");
-    // output(0, 0.0);
-    timer_output.leave_subsection();
-    pcout << "-----------------------------------------------" << std::endl;
-  }
+      for (unsigned int e = 0; e < PerfCounters::n_events; ++e)
+        values.push_back(found ? counts->second.values[e] : 0.0);
+      values.push_back(found ? static_cast<double>(counts->second.n_calls) : 0.0);
+    }
 
-  unsigned int time_step = 0;
+  std::vector<double> totals(values.size());
+  MPI_Reduce(values.data(), totals.data(), values.size(), MPI_DOUBLE, MPI_SUM, 0, mpi_comm);
 
-    while (time < T - 0.5 * deltat) {
-      time += deltat;
-      ++time_step;
+  if (mpi_rank != 0)
+    return;
 
-      // Store the old solution, so that it is available for assembly.
-      solution_old = solution;
+  const double n_dofs    = static_cast<double>(dof_handler.n_dofs());
+  const double line_size = PerfCounters::cache_line_size();
 
-      pcout << "n = " << std::setw(3) << time_step << ", t = " << std::setw(5)
-            << std::fixed << time << std::endl;
+  const auto print_row = [this](const std::string &name, const auto &...columns) {
+    pcout << "  " << std::left << std::setw(28) << name << std::right;
+    ((pcout << std::setw(11) << columns), ...);
+    pcout << std::endl;
+  };
 
-      // At every time step, we invoke Newton's method to solve the non-linear
-      // problem.
-      solve_newton();
+  // Cache misses stand for the memory traffic, one line each. Rates use the
+  // wall time of the slowest process.
+  pcout << "Hardware counters (all processes, thread entering each section)" << std::endl;
+  pcout << std::scientific << std::setprecision(3);
+
+  print_row("", "cycles", "instr.", "IPC", "misses", "bytes/DoF", "GB/s", "GFLOP/s");
+
+  unsigned int k = 0;
+    for (const auto &[section, time] : times) {
+      const double *counts  = &totals[k * (PerfCounters::n_events + 1)];
+      const double  n_calls = counts[PerfCounters::n_events] / mpi_size;
+      const double  bytes   = counts[PerfCounters::cache_misses] * line_size;
+      ++k;
+
+      if (n_calls == 0.0)
+        continue;
+
+      const double ipc = (counts[PerfCounters::cycles] > 0.0) ?
+                           counts[PerfCounters::instructions] / counts[PerfCounters::cycles] :
+                           0.0;
+      const double bandwidth = (time.max > 0.0) ? bytes / time.max * 1e-9 : 0.0;
+      const double gflops    = (count_flops && time.max > 0.0) ?
+                                 counts[PerfCounters::flops] / time.max * 1e-9 :
+                                 0.0;
+
+      print_row(section,
+                counts[PerfCounters::cycles],
+                counts[PerfCounters::instructions],
+                ipc,
+                counts[PerfCounters::cache_misses],
+                bytes / (n_dofs * n_calls),
+                bandwidth,
+                gflops);
+    }
+
+  if (!count_flops)
+    pcout << "  (FLOPs not counted: set perf_flops_event to the raw event of this processor)"
+          << std::endl;
+
+  pcout << std::defaultfloat << std::setprecision(6);
+}
+
+template <int dim, unsigned int degree>
+void
+HeatNonLinear<dim, degree>::local_assemble_system_cached(
+  const typename DoFHandler<dim>::active_cell_iterator &cell,
+  AssemblyScratchData                                  &scratch_data,
+  AssemblyCopyData                                     &copy_data) {
+  const unsigned int dofs_per_cell = geometry_cache.dofs_per_cell();
+  const unsigned int n_q           = geometry_cache.n_q_points();
+
+  const unsigned int c = owned_cell_index[cell->active_cell_index()];
+
+  const double                  *JxW       = geometry_cache.JxW(c);
+  const Tensor<1, dim>          *grad_phi  = geometry_cache.shape_gradients(c);
+  const Tensor<1, dim>          *D_grad    = geometry_cache.D_shape_gradients(c);
+  const double                  *alpha_loc = geometry_cache.alpha(c);
+  const types::global_dof_index *indices   = geometry_cache.dof_indices(c);
+
+  std::vector<double>         &solution_dofs         = scratch_data.solution_dofs;
+  std::vector<double>         &base_dofs             = scratch_data.base_dofs;
+  std::vector<double>         &solution_loc          = scratch_data.solution_loc;
+  std::vector<Tensor<1, dim>> &solution_gradient_loc = scratch_data.solution_gradient_loc;
+  std::vector<double>         &base_loc              = scratch_data.base_loc;
+
+    for (unsigned int i = 0; i < dofs_per_cell; ++i) {
+      copy_data.dof_indices[i] = indices[i];
+      solution_dofs[i]         = solution(indices[i]);
+      base_dofs[i]             = stage_base(indices[i]);
+    }
+
+    for (unsigned int q = 0; q < n_q; ++q) {
+      solution_loc[q]          = 0.0;
+      solution_gradient_loc[q] = 0.0;
+      base_loc[q]              = 0.0;
+
+        for (unsigned int i = 0; i < dofs_per_cell; ++i) {
+          const double phi_i = geometry_cache.shape_value(i, q);
 
-      timer_output.enter_subsection("Writing");
-      if (time_step % 10 == 0)
-        // output(time_step, time);
-      timer_output.leave_subsection();
+          solution_loc[q] += phi_i * solution_dofs[i];
+          base_loc[q] += phi_i * base_dofs[i];
+          solution_gradient_loc[q] += solution_dofs[i] * grad_phi[q * dofs_per_cell + i];
+        }
+    }
 
-      pcout << std::endl;
+  copy_data.cell_matrix   = 0.0;
+  copy_data.cell_residual = 0.0;
+  copy_data.cell_diagonal = 0.0;
+
+    for (unsigned int q = 0; q < n_q; ++q) {
+      // Coefficient of phi_i phi_j in the Jacobian (mass and linearized
+      // reaction), and of phi_i in the residual (time derivative and
+      // reaction).
+      const double reaction_loc      = alpha_loc[q] * (1 - 2 * solution_loc[q]);
+      const double value_coefficient = (1.0 / stage_deltat - reaction_loc) * JxW[q];
+      const double value_residual =
+        ((solution_loc[q] - base_loc[q]) / stage_deltat -
+         alpha_loc[q] * solution_loc[q] * (1 - solution_loc[q])) *
+        JxW[q];
+
+      if (scratch_data.assemble_operator)
+        reaction_coefficient[c * n_q + q] = reaction_loc;
+
+        for (unsigned int i = 0; i < dofs_per_cell; ++i) {
+          const double          phi_i    = geometry_cache.shape_value(i, q);
+          const Tensor<1, dim> &D_grad_i = D_grad[q * dofs_per_cell + i];
+
+          // D is symmetric, so grad(phi_i) . D grad(v) = D grad(phi_i) . grad(v).
+          if (scratch_data.assemble_matrix)
+            for (unsigned int j = 0; j < dofs_per_cell; ++j)
+              copy_data.cell_matrix(i, j) +=
+                phi_i * geometry_cache.shape_value(j, q) * value_coefficient +
+                D_grad_i * grad_phi[q * dofs_per_cell + j] * JxW[q];
+
+          if (scratch_data.assemble_operator)
+            copy_data.cell_diagonal(i) += phi_i * phi_i * value_coefficient +
+                                          D_grad_i * grad_phi[q * dofs_per_cell + i] * JxW[q];
+
+          // Residual (with changed sign).
+          copy_data.cell_residual(i) -=
+            phi_i * value_residual + D_grad_i * solution_gradient_loc[q] * JxW[q];
+        }
     }
-}
\ No newline at end of file
+}
+
+template <int dim, unsigned int degree>
+void
+HeatNonLinear<dim, degree>::local_assemble_system(
+  const typename DoFHandler<dim>::active_cell_iterator &cell,
+  AssemblyScratchData                                  &scratch_data,
+  AssemblyCopyData                                     &copy_data) {
+  const unsigned int dofs_per_cell = fe->dofs_per_cell;
+  const unsigned int n_q           = quadrature->size();
+
+  // Index of the current cell among the locally owned ones.
+  const unsigned int cell_index = owned_cell_index[cell->active_cell_index()];
+
+  const Tensor<2, dim> D_cell       = diffusivity(cell_index, cell->material_id());
+  const double         region_alpha = region(cell->material_id()).alpha;
+
+  FEValues<dim>      &fe_values     = scratch_data.fe_values;
+  FullMatrix<double> &cell_matrix   = copy_data.cell_matrix;
+  Vector<double>     &cell_residual = copy_data.cell_residual;
+  Vector<double>     &cell_diagonal = copy_data.cell_diagonal;
+
+  // Value and gradient of the solution on current cell.
+  std::vector<double>         &solution_loc          = scratch_data.solution_loc;
+  std::vector<Tensor<1, dim>> &solution_gradient_loc = scratch_data.solution_gradient_loc;
+
+  // Value of the stage base (u n for backward Euler) on current cell.
+  std::vector<double> &base_loc = scratch_data.base_loc;
+
+  fe_values.reinit(cell);
+
+  cell_matrix   = 0.0;
+  cell_residual = 0.0;
+  cell_diagonal = 0.0;
+
+  fe_values.get_function_values(solution, solution_loc);             // u n+1
+  fe_values.get_function_gradients(solution, solution_gradient_loc); // grad u n+1
+  fe_values.get_function_values(stage_base, base_loc);               // w
+
+    for (unsigned int q = 0; q < n_q; ++q) {
+      // Evaluate coefficients on this quadrature node.
+      const double alpha_loc = alpha_value(fe_values, q, region_alpha);
+
+        if (scratch_data.assemble_operator) {
+          const double reaction_loc = alpha_loc * (1 - 2 * solution_loc[q]);
+          reaction_coefficient[cell_index * n_q + q] = reaction_loc;
+
+            for (unsigned int i = 0; i < dofs_per_cell; ++i) {
+              const double phi_i = fe_values.shape_value(i, q);
+              cell_diagonal(i) += (phi_i * phi_i * (1.0 / stage_deltat - reaction_loc) +
+                                   fe_values.shape_grad(i, q) * D_cell *
+                                     fe_values.shape_grad(i, q)) *
+                                  fe_values.JxW(q);
+            }
+        }
+
+        for (unsigned int i = 0; i < dofs_per_cell; ++i) {
+            if (scratch_data.assemble_matrix) {
+                for (unsigned int j = 0; j < dofs_per_cell; ++j) {
+                  // ------------------------------------------- (A.1)
+                  // ------------------------------------------- // Mass matrix.
+                  cell_matrix(i, j) += fe_values.shape_value(i, q) *
+                                       fe_values.shape_value(j, q) / stage_deltat *
+                                       fe_values.JxW(q);
+
+                  // ------------------------------------------- (A.2)
+                  // ------------------------------------------- // Non-linear stiffness
+                  // matrix, first term.
+                  cell_matrix(i, j) += fe_values.shape_grad(i, q) * D_cell *
+                                       fe_values.shape_grad(j, q) * fe_values.JxW(q);
+
+                  // ------------------------------------------- (A.3)
+                  // ------------------------------------------- // Non-linear stiffness
+                  // matrix, second term.
+                  cell_matrix(i, j) -= fe_values.shape_value(i, q) * alpha_loc *
+                                       (1 - 2 * solution_loc[q]) *
+                                       fe_values.shape_value(j, q) * fe_values.JxW(q);
+                }
+            }
+
+          // Assemble the residual vector (with changed sign).
+
+          // ------------------------------------------- (R.1)
+          // ------------------------------------------- // Time derivative term.
+          cell_residual(i) -= fe_values.shape_value(i, q) *
+                              (solution_loc[q] - base_loc[q]) / stage_deltat *
+                              fe_values.JxW(q);
+
+          // ------------------------------------------- (R.2)
+          // ------------------------------------------- //
+          cell_residual(i) -= fe_values.shape_grad(i, q) * D_cell *
+                              solution_gradient_loc[q] * fe_values.JxW(q);
+
+          // ------------------------------------------- (R.3)
+          // ------------------------------------------- // Diffusion term.
+          cell_residual(i) += fe_values.shape_value(i, q) *
+                              (alpha_loc * solution_loc[q] * (1 - solution_loc[q])) *
+                              fe_values.JxW(q);
+        }
+    }
+
+  cell->get_dof_indices(copy_data.dof_indices);
+}
+
+template <int dim, unsigned int degree>
+void
+HeatNonLinear<dim, degree>::assemble_system(const bool &assemble_jacobian) {
+    if (settings.jacobian_mode == HeatNonLinearSettings::JacobianMode::assembled &&
+        settings.assembly != HeatNonLinearSettings::Assembly::full) {
+      assemble_reaction_system(assemble_jacobian);
+      return;
+    }
+
+  const bool matrix_free =
+    (settings.jacobian_mode == HeatNonLinearSettings::JacobianMode::matrix_free);
+
+  // What to update besides the residual: the Jacobian matrix, or the data
+  // of the matrix-free operator (nothing if the Jacobian is frozen).
+  const bool assemble_matrix   = assemble_jacobian && !matrix_free;
+  const bool assemble_operator = assemble_jacobian && matrix_free;
+
+  // In matrix-free mode, only the diagonal of the Jacobian is assembled, to
+  // build the Jacobi preconditioner.
+  TrilinosWrappers::MPI::Vector diagonal;
+
+  if (assemble_operator)
+    diagonal.reinit(locally_owned_dofs, mpi_comm);
+  else if (assemble_matrix)
+    jacobian_matrix = 0.0;
+
+  residual_vector = 0.0;
+
+  const auto copy_local_to_global = [&](const AssemblyCopyData &copy_data) {
+    if (assemble_operator)
+      diagonal.add(copy_data.dof_indices, copy_data.cell_diagonal);
+    else if (assemble_matrix)
+      jacobian_matrix.add(copy_data.dof_indices, copy_data.cell_matrix);
+    residual_vector.add(copy_data.dof_indices, copy_data.cell_residual);
+  };
+
+    if (use_batch_kernel()) {
+      // Batches of consecutive cached cells, identified by their first cell.
+      std::vector<unsigned int> batches;
+      for (unsigned int c = 0; c < geometry_cache.n_cells();
+           c += VectorizedArray<double>::size())
+        batches.push_back(c);
+
+      WorkStream::run(
+        batches.cbegin(),
+        batches.cend(),
+        [this](const std::vector<unsigned int>::const_iterator &batch,
+               AssemblyScratchData                             &scratch_data,
+               AssemblyBatchCopyData                           &copy_data) {
+          local_assemble_batch(*batch, scratch_data, copy_data);
+        },
+        [&](const AssemblyBatchCopyData &copy_data) {
+          for (unsigned int v = 0; v < copy_data.n_filled; ++v)
+            copy_local_to_global(copy_data.cells[v]);
+        },
+        AssemblyScratchData(*fe, *quadrature, alpha_flags(), assemble_matrix, assemble_operator),
+        AssemblyBatchCopyData(fe->dofs_per_cell));
+    } else {
+      using CellFilter = FilteredIterator<typename DoFHandler<dim>::active_cell_iterator>;
+
+      // The owned cells are split among the threads of this process, each
+      // with its own scratch data. The copier adds the cell contributions to
+      // the global objects one at a time, so that no coloring is needed.
+      WorkStream::run(
+        CellFilter(IteratorFilters::LocallyOwnedCell(), dof_handler.begin_active()),
+        CellFilter(IteratorFilters::LocallyOwnedCell(), dof_handler.end()),
+        [this](const typename DoFHandler<dim>::active_cell_iterator &cell,
+               AssemblyScratchData                                  &scratch_data,
+               AssemblyCopyData                                     &copy_data) {
+          if (settings.cache_geometry)
+            local_assemble_system_cached(cell, scratch_data, copy_data);
+          else
+            local_assemble_system(cell, scratch_data, copy_data);
+        },
+        copy_local_to_global,
+        AssemblyScratchData(*fe, *quadrature, alpha_flags(), assemble_matrix, assemble_operator),
+        AssemblyCopyData(fe->dofs_per_cell));
+    }
+
+  residual_vector.compress(VectorOperation::add);
+
+    if (assemble_operator) {
+      diagonal.compress(VectorOperation::add);
+
+      for (auto &d : diagonal)
+        d = 1.0 / d;
+
+      jacobi_preconditioner.reinit(diagonal);
+    } else if (assemble_matrix) {
+      jacobian_matrix.compress(VectorOperation::add);
+    }
+
+  // We apply Dirichlet boundary conditions.
+  // The linear system solution is delta, which is the difference between
+  // u_{n+1}^{(k+1)} and u_{n+1}^{(k)}. Both must satisfy the same Dirichlet
+  // boundary conditions: therefore, on the boundary, delta = u_{n+1}^{(k+1)} -
+  // u_{n+1}^{(k+1)} = 0. We impose homogeneous Dirichlet BCs.
+  // {
+  //   std::map<types::global_dof_index, double> boundary_values;
+
+  //   std::map<types::boundary_id, const Function<dim> *> boundary_functions;
+  //   Functions::ZeroFunction<dim>                        zero_function;
+
+  //   for (unsigned int i = 0; i < 6; ++i)
+  //     boundary_functions[i] = &zero_function;
+
+  //   VectorTools::interpolate_boundary_values(dof_handler,
+  //                                            boundary_functions,
+  //                                            boundary_values);
+
+  //   MatrixTools::apply_boundary_values(
+  //     boundary_values, jacobian_matrix, delta_owned, residual_vector, false);
+  // }
+}
+
+template <int dim, unsigned int degree>
+void
+HeatNonLinear<dim, degree>::setup_amg_preconditioner() {
+  enter_section("Setup preconditioner");
+  Timer timer;
+
+  TrilinosWrappers::PreconditionAMG::AdditionalData amg_data;
+  amg_data.elliptic              = true;
+  amg_data.higher_order_elements = (r > 1);
+  amg_data.smoother_sweeps       = 2;
+  amg_data.aggregation_threshold = 0.02;
+
+  amg_preconditioner.initialize(jacobian_matrix, amg_data);
+
+  step_telemetry.preconditioner_time += timer.wall_time();
+  leave_section();
+
+  amg_outdated             = false;
+  amg_reference_iterations = 0;
+
+  pcout_steps << "  AMG preconditioner rebuilt" << std::endl;
+}
+
+template <int dim, unsigned int degree>
+void
+HeatNonLinear<dim, degree>::solve_linear_system(const double &tolerance) {
+  // The preconditioner setup is accounted for separately.
+  Timer        timer;
+  const double preconditioner_time = step_telemetry.preconditioner_time;
+
+  SolverControl solver_control(1000, tolerance);
+
+  SolverCG<TrilinosWrappers::MPI::Vector> solver(solver_control);
+  // SolverGMRES<TrilinosWrappers::MPI::Vector> solver(solver_control);
+
+    if (settings.jacobian_mode == HeatNonLinearSettings::JacobianMode::matrix_free) {
+      solver.solve(jacobian_operator, delta_owned, residual_vector, jacobi_preconditioner);
+    } else if (settings.preconditioner == HeatNonLinearSettings::Preconditioner::amg) {
+      // The AMG hierarchy built from an older Jacobian is still a good
+      // preconditioner for the current one, since the matrix changes little
+      // between Newton iterations and time steps. We only rebuild it when it
+      // was flagged as outdated, or when it fails to converge at all.
+      if (amg_outdated)
+        setup_amg_preconditioner();
+
+        try {
+          solver.solve(jacobian_matrix, delta_owned, residual_vector, amg_preconditioner);
+        } catch (const SolverControl::NoConvergence &) {
+          if (amg_reference_iterations == 0)
+            throw;
+
+          setup_amg_preconditioner();
+          solver.solve(jacobian_matrix, delta_owned, residual_vector, amg_preconditioner);
+        }
+
+      // The first solve after a rebuild sets the reference iteration count;
+      // once the count drifts past the allowed factor, the hierarchy is
+      // rebuilt before the next solve.
+      if (amg_reference_iterations == 0)
+        amg_reference_iterations = std::max(solver_control.last_step(), 1u);
+      else if (solver_control.last_step() >
+               settings.amg_rebuild_factor * amg_reference_iterations)
+        amg_outdated = true;
+    } else {
+        if (ssor_outdated) {
+          Timer ssor_timer;
+          ssor_preconditioner.initialize(
+            jacobian_matrix, TrilinosWrappers::PreconditionSSOR::AdditionalData(1.0));
+          ssor_outdated = false;
+          step_telemetry.preconditioner_time += ssor_timer.wall_time();
+        }
+
+      solver.solve(jacobian_matrix, delta_owned, residual_vector, ssor_preconditioner);
+    }
+  n_linear += solver_control.last_step();
+
+  step_telemetry.linear_iterations += solver_control.last_step();
+  step_telemetry.solve_time +=
+    timer.wall_time() - (step_telemetry.preconditioner_time - preconditioner_time);
+
+  pcout_steps << "  " << solver_control.last_step() << " CG iterations" << std::endl;
+  // pcout_steps << "  " << solver_control.last_step() << " GMRES iterations" << std::endl;
+}
+
+template <int dim, unsigned int degree>
+void
+HeatNonLinear<dim, degree>::JacobianOperator::vmult(
+  TrilinosWrappers::MPI::Vector       &dst,
+  const TrilinosWrappers::MPI::Vector &src) const {
+  const unsigned int dofs_per_cell = problem.fe->dofs_per_cell;
+  const unsigned int n_q           = problem.quadrature->size();
+
+  // The cell loop needs the ghost values of src.
+  if (src_ghosted.size() == 0)
+    src_ghosted.reinit(problem.locally_owned_dofs,
+                       problem.locally_relevant_dofs,
+                       problem.mpi_comm);
+  problem.update_ghost_values(src_ghosted, src);
+
+  dst = 0.0;
+
+  // Threads as in assemble_system(): the product on a cell goes to
+  // cell_residual, and src takes the place of the solution in the scratch
+  // data.
+  const auto copy_local_to_global = [&dst](const AssemblyCopyData &copy_data) {
+    dst.add(copy_data.dof_indices, copy_data.cell_residual);
+  };
+
+  const AssemblyScratchData sample_scratch_data(
+    *problem.fe, *problem.quadrature, update_default, false, false);
+  const AssemblyCopyData sample_copy_data(dofs_per_cell);
+
+    if (problem.settings.cache_geometry) {
+      const CellGeometryCache<dim> &cache = problem.geometry_cache;
+
+        if (cached_cells.size() != cache.n_cells()) {
+          cached_cells.resize(cache.n_cells());
+          for (unsigned int c = 0; c < cache.n_cells(); ++c)
+            cached_cells[c] = c;
+        }
+
+      const auto local_vmult = [&](const std::vector<unsigned int>::const_iterator &cell,
+                                   AssemblyScratchData                             &scratch_data,
+                                   AssemblyCopyData                                &copy_data) {
+        const unsigned int c = *cell;
+
+        const double                  *JxW      = cache.JxW(c);
+        const Tensor<1, dim>          *grad_phi = cache.shape_gradients(c);
+        const Tensor<1, dim>          *D_grad   = cache.D_shape_gradients(c);
+        const types::global_dof_index *indices  = cache.dof_indices(c);
+
+        std::vector<double> &src_dofs = scratch_data.solution_dofs;
+        Vector<double>      &cell_dst = copy_data.cell_residual;
+
+          for (unsigned int i = 0; i < dofs_per_cell; ++i) {
+            copy_data.dof_indices[i] = indices[i];
+            src_dofs[i]              = src_ghosted(indices[i]);
+          }
+
+        cell_dst = 0.0;
+
+          for (unsigned int q = 0; q < n_q; ++q) {
+            double         src_value = 0.0;
+            Tensor<1, dim> src_gradient;
+
+              for (unsigned int j = 0; j < dofs_per_cell; ++j) {
+                src_value += cache.shape_value(j, q) * src_dofs[j];
+                src_gradient += src_dofs[j] * grad_phi[q * dofs_per_cell + j];
+              }
+
+            const double value_coefficient =
+              (1.0 / problem.stage_deltat - problem.reaction_coefficient[c * n_q + q]) *
+              src_value * JxW[q];
+
+            for (unsigned int i = 0; i < dofs_per_cell; ++i)
+              cell_dst(i) += cache.shape_value(i, q) * value_coefficient +
+                             D_grad[q * dofs_per_cell + i] * src_gradient * JxW[q];
+          }
+      };
+
+      WorkStream::run(cached_cells.cbegin(),
+                      cached_cells.cend(),
+                      local_vmult,
+                      copy_local_to_global,
+                      sample_scratch_data,
+                      sample_copy_data);
+
+      dst.compress(VectorOperation::add);
+      return;
+    }
+
+  const auto local_vmult = [&](const typename DoFHandler<dim>::active_cell_iterator &cell,
+                               AssemblyScratchData                                  &scratch_data,
+                               AssemblyCopyData                                     &copy_data) {
+    FEValues<dim>  &fe_values = scratch_data.fe_values;
+    Vector<double> &cell_dst  = copy_data.cell_residual;
+
+    // Value and gradient of the input vector on the cell.
+    std::vector<double>         &src_loc          = scratch_data.solution_loc;
+    std::vector<Tensor<1, dim>> &src_gradient_loc = scratch_data.solution_gradient_loc;
+
+    fe_values.reinit(cell);
+
+    const unsigned int   cell_index = problem.owned_cell_index[cell->active_cell_index()];
+    const Tensor<2, dim> D_cell     = problem.diffusivity(cell_index, cell->material_id());
+
+    cell_dst = 0.0;
+
+    fe_values.get_function_values(src_ghosted, src_loc);
+    fe_values.get_function_gradients(src_ghosted, src_gradient_loc);
+
+      for (unsigned int q = 0; q < n_q; ++q) {
+        // Mass and reaction terms share the same test function, so they are
+        // combined in a single coefficient.
+        const double value_coefficient =
+          (1.0 / problem.stage_deltat - problem.reaction_coefficient[cell_index * n_q + q]) *
+          src_loc[q] * fe_values.JxW(q);
+        const Tensor<1, dim> flux = D_cell * src_gradient_loc[q] * fe_values.JxW(q);
+
+        for (unsigned int i = 0; i < dofs_per_cell; ++i)
+          cell_dst(i) += fe_values.shape_value(i, q) * value_coefficient +
+                         fe_values.shape_grad(i, q) * flux;
+      }
+
+    cell->get_dof_indices(copy_data.dof_indices);
+  };
+
+  using CellFilter = FilteredIterator<typename DoFHandler<dim>::active_cell_iterator>;
+
+  WorkStream::run(
+    CellFilter(IteratorFilters::LocallyOwnedCell(), problem.dof_handler.begin_active()),
+    CellFilter(IteratorFilters::LocallyOwnedCell(), problem.dof_handler.end()),
+    local_vmult,
+    copy_local_to_global,
+    sample_scratch_data,
+    sample_copy_data);
+
+  dst.compress(VectorOperation::add);
+}
+
+template <int dim, unsigned int degree>
+bool
+HeatNonLinear<dim, degree>::solve_newton() {
+  const unsigned int n_max_iters = settings.newton_max_iterations;
+
+  unsigned int n_iter        = 0;
+  double       residual_norm = 0.0;
+  bool         converged     = false;
+
+  // Mixed criterion: the absolute tolerance, or the relative one with respect
+  // to the initial residual of the time step, whichever is larger.
+  double residual_tolerance = settings.newton_absolute_tolerance;
+
+  // Residual norm of the previous iteration and linear solver relative
+  // tolerance (forcing term).
+  double residual_norm_old = 0.0;
+  double forcing_term      = settings.linear_tolerance;
+
+  // We apply the boundary conditions to the initial guess (which is stored in
+  // solution_owned and solution).
+  {
+    //?????
+  }
+
+    while (n_iter < n_max_iters) {
+      // With a frozen Jacobian (modified Newton), only the residual is
+      // assembled.
+      bool update_jacobian = !settings.lag_jacobian || jacobian_outdated;
+
+      enter_section("Assemble system");
+      Timer timer;
+      assemble_system(update_jacobian);
+      step_telemetry.assembly_time += timer.wall_time();
+      leave_section();
+      residual_norm = residual_vector.l2_norm();
+
+      step_telemetry.residual_norms.push_back(residual_norm);
+
+      if (n_iter == 0)
+        residual_tolerance = std::max(settings.newton_absolute_tolerance,
+                                      settings.newton_relative_tolerance * residual_norm);
+
+        // If the frozen Jacobian no longer contracts the residual fast enough,
+        // we refresh it before solving.
+        if (!update_jacobian && n_iter > 0 && residual_norm > residual_tolerance &&
+            residual_norm > settings.jacobian_refresh_contraction * residual_norm_old) {
+          enter_section("Assemble system");
+          timer.restart();
+          assemble_system(true);
+          step_telemetry.assembly_time += timer.wall_time();
+          leave_section();
+
+          update_jacobian = true;
+        }
+
+        if (update_jacobian) {
+          jacobian_outdated = false;
+          ssor_outdated     = true;
+        }
+
+      pcout_steps << "  Newton iteration " << n_iter << "/" << n_max_iters
+                  << " - ||r|| = " << std::scientific << std::setprecision(6) << residual_norm
+                  << std::flush;
+
+        // We actually solve the system only if the residual is larger than the
+        // tolerance.
+        if (residual_norm <= residual_tolerance) {
+          pcout_steps << " < tolerance" << std::endl;
+          converged = true;
+          break;
+        }
+
+        // A diverged iteration will not come back.
+        if (!std::isfinite(residual_norm)) {
+          pcout_steps << std::endl;
+          break;
+        }
+
+        // Eisenstat-Walker forcing term (choice 2), with the usual safeguards
+        // against a too fast decrease and against oversolving near
+        // convergence.
+        if (settings.forcing_term == HeatNonLinearSettings::ForcingTerm::eisenstat_walker &&
+            n_iter > 0) {
+          const double gamma    = settings.eisenstat_walker_gamma;
+          const double exponent = settings.eisenstat_walker_exponent;
+
+          const double forcing_term_old = forcing_term;
+
+          forcing_term = gamma * std::pow(residual_norm / residual_norm_old, exponent);
+
+          const double safeguard = gamma * std::pow(forcing_term_old, exponent);
+          if (safeguard > 0.1)
+            forcing_term = std::max(forcing_term, safeguard);
+
+          forcing_term = std::min(forcing_term, settings.eisenstat_walker_max);
+          forcing_term = std::max(forcing_term, 0.5 * residual_tolerance / residual_norm);
+        }
+
+      enter_section("Solve linear system");
+      solve_linear_system(forcing_term * residual_norm);
+      leave_section();
+
+      solution_owned += delta_owned;
+      update_ghost_values(solution, solution_owned);
+
+      residual_norm_old = residual_norm;
+      ++n_iter;
+    }
+
+  n_newton += n_iter;
+  step_telemetry.newton_iterations += n_iter;
+
+  return converged;
+}
+
+template <int dim, unsigned int degree>
+bool
+HeatNonLinear<dim, degree>::solve_stage(const double &tau) {
+  // The Jacobian depends on the step of the stage.
+  if (tau != stage_deltat)
+    jacobian_outdated = true;
+  stage_deltat = tau;
+
+  update_ghost_values(stage_base, stage_base_owned);
+
+  return solve_newton();
+}
+
+template <int dim, unsigned int degree>
+bool
+HeatNonLinear<dim, degree>::solve_time_step(const unsigned int &time_step) {
+  using TimeScheme = HeatNonLinearSettings::TimeScheme;
+
+  const TimeScheme scheme = settings.time_scheme;
+
+    if (scheme == TimeScheme::bdf2 && time_step > 1) {
+      // (3 u - 4 u n + u n-1) / (2 deltat) = M^-1 F(u).
+      stage_base_owned = solution_old_owned;
+      stage_base_owned.sadd(4.0 / 3.0, -1.0 / 3.0, solution_older_owned);
+
+      return solve_stage(2.0 / 3.0 * deltat);
+    } else if (scheme == TimeScheme::theta && time_derivative_available) {
+      // (u - u n) / deltat = theta M^-1 F(u) + (1 - theta) M^-1 F(u n).
+      const double theta = settings.time_theta;
+
+      stage_base_owned = solution_old_owned;
+      stage_base_owned.add((1.0 - theta) * deltat, time_derivative_owned);
+
+      if (!solve_stage(theta * deltat))
+        return false;
+
+      time_derivative_owned = solution_owned;
+      time_derivative_owned -= stage_base_owned;
+      time_derivative_owned *= 1.0 / (theta * deltat);
+    } else if (scheme == TimeScheme::sdirk2 || scheme == TimeScheme::sdirk3) {
+      // U_i = u n + deltat sum_j a_ij M^-1 F(U_j), every stage starting from
+      // the previous one.
+      const std::vector<std::vector<double>> a =
+        sdirk_coefficients(scheme == TimeScheme::sdirk2 ? 2 : 3);
+      const unsigned int n_stages = a.size();
+      const double       tau      = a[0][0] * deltat;
+
+      stage_derivatives.resize(n_stages - 1);
+
+        for (unsigned int i = 0; i < n_stages; ++i) {
+          stage_base_owned = solution_old_owned;
+          for (unsigned int j = 0; j < i; ++j)
+            stage_base_owned.add(a[i][j] * deltat, stage_derivatives[j]);
+
+          if (!solve_stage(tau))
+            return false;
+
+            // The last stage is the solution of the step.
+            if (i + 1 < n_stages) {
+              stage_derivatives[i] = solution_owned;
+              stage_derivatives[i] -= stage_base_owned;
+              stage_derivatives[i] *= 1.0 / tau;
+            }
+        }
+    } else {
+      // Backward Euler, which also starts the schemes needing the previous
+      // step.
+      stage_base_owned = solution_old_owned;
+
+      if (!solve_stage(deltat))
+        return false;
+
+        if (scheme == TimeScheme::theta) {
+          time_derivative_owned = solution_owned;
+          time_derivative_owned -= solution_old_owned;
+          time_derivative_owned *= 1.0 / deltat;
+          time_derivative_available = true;
+        }
+    }
+
+  return true;
+}
+
+template <int dim, unsigned int degree>
+void
+HeatNonLinear<dim, degree>::solve_reaction(const double &tau) {
+  // The logistic equation dc/dt = alpha c (1 - c) has the exact solution
+  // c(tau) = c e^(alpha tau) / (1 + c (e^(alpha tau) - 1)), applied node by
+  // node on the owned entries.
+  double       *u = solution_owned.begin();
+  const double *a = alpha_nodal.begin();
+
+  parallel::apply_to_subranges(
+    0u,
+    locally_owned_dofs.n_elements(),
+    [&](const unsigned int &begin, const unsigned int &end) {
+        for (unsigned int k = begin; k < end; ++k) {
+          const double growth = std::exp(a[k] * tau);
+          u[k]                = u[k] * growth / (1.0 + u[k] * (growth - 1.0));
+        }
+    },
+    nodal_grain_size);
+}
+
+template <int dim, unsigned int degree>
+void
+HeatNonLinear<dim, degree>::solve_splitting_step() {
+  enter_section("Reaction step");
+  solve_reaction(0.5 * deltat);
+  leave_section();
+
+  // Diffusion over the whole step with Crank-Nicolson, to keep the splitting
+  // second order: (M / dt + K / 2) u_new = (M / dt - K / 2) u. The matrix is
+  // stored in jacobian_matrix and only rebuilt when the time step changes,
+  // so its preconditioner is set up once.
+    if (jacobian_outdated) {
+      enter_section("Assemble system");
+      Timer timer;
+      jacobian_matrix = 0.0;
+      jacobian_matrix.add(0.5, stiffness_matrix);
+      jacobian_matrix.add(1.0 / deltat, mass_matrix);
+      step_telemetry.assembly_time += timer.wall_time();
+      leave_section();
+
+      jacobian_outdated = false;
+      ssor_outdated     = true;
+      amg_outdated      = true;
+    }
+
+  TrilinosWrappers::MPI::Vector tmp(locally_owned_dofs, mpi_comm);
+
+  mass_matrix.vmult(residual_vector, solution_owned);
+  residual_vector *= 1.0 / deltat;
+  stiffness_matrix.vmult(tmp, solution_owned);
+  residual_vector.add(-0.5, tmp);
+
+  // The linear solver works on delta_owned, which here holds the new
+  // solution itself; the old one is a good initial guess.
+  delta_owned = solution_owned;
+
+  enter_section("Solve linear system");
+  solve_linear_system(settings.linear_tolerance * residual_vector.l2_norm());
+  leave_section();
+
+  solution_owned = delta_owned;
+
+  enter_section("Reaction step");
+  solve_reaction(0.5 * deltat);
+  leave_section();
+
+  update_ghost_values(solution, solution_owned);
+}
+
+template <int dim, unsigned int degree>
+void
+HeatNonLinear<dim, degree>::output(const unsigned int                  &time_step,
+                                   const double                        &time,
+                                   const TrilinosWrappers::MPI::Vector &u) {
+  Timer timer;
+
+  // The buffer of this job was written at the previous output at the latest.
+  OutputJob &job      = output_jobs[n_output_jobs % 2];
+  OutputJob &previous = output_jobs[(n_output_jobs + 1) % 2];
+  ++n_output_jobs;
+
+  if (job.solution.size() == 0)
+    job.solution.reinit(locally_owned_dofs, locally_relevant_dofs, mpi_comm);
+  job.solution  = u;
+  job.time_step = time_step;
+  job.time      = time;
+  job.pending   = true;
+
+  job.thread = std::thread([this, &job]() { build_output_patches(job); });
+
+  // The previous job is written while the patches of this one are built.
+  if (previous.pending)
+    write_output_job(previous);
+
+  if (!settings.asynchronous_output)
+    write_output_job(job);
+
+  step_telemetry.output_time += timer.wall_time();
+}
+
+template <int dim, unsigned int degree>
+void
+HeatNonLinear<dim, degree>::build_output_patches(OutputJob &job) const {
+  DataOut<dim> data_out;
+  data_out.add_data_vector(dof_handler, job.solution, "u");
+
+  // std::vector<unsigned int> partition_int(mesh.n_active_cells());
+  // GridTools::get_subdomain_association(mesh, partition_int);
+  // const Vector<double> partitioning(partition_int.begin(), partition_int.end());
+  // data_out.add_data_vector(partitioning, "partitioning");
+
+  data_out.build_patches();
+
+  job.data_filter = std::make_unique<DataOutBase::DataOutFilter>(
+    DataOutBase::DataOutFilterFlags(/*filter_duplicate_vertices = */ false,
+                                    /*xdmf_hdf5_output = */ true));
+  data_out.write_filtered_data(*job.data_filter);
+}
+
+template <int dim, unsigned int degree>
+void
+HeatNonLinear<dim, degree>::write_output_job(OutputJob &job) {
+  job.thread.join();
+
+  output_writer->write(*job.data_filter, job.time_step, job.time);
+
+  job.data_filter.reset();
+  job.pending = false;
+}
+
+template <int dim, unsigned int degree>
+void
+HeatNonLinear<dim, degree>::finish_output() {
+  SectionScope section(*this, "Writing");
+
+  // The oldest job is the one the next output would use.
+    for (unsigned int k = 0; k < 2; ++k) {
+      OutputJob &job = output_jobs[(n_output_jobs + k) % 2];
+      if (job.pending)
+        write_output_job(job);
+    }
+}
+
+template <int dim, unsigned int degree>
+void
+HeatNonLinear<dim, degree>::open_telemetry(const bool &restart) {
+  if (settings.telemetry_file_name.empty() || mpi_rank != 0)
+    return;
+
+  // A new run starts a new file, a restarted one appends to it once solve()
+  // has dropped the rows after the checkpoint.
+  const std::string file_name = run_file_name(settings.telemetry_file_name);
+  const bool        new_file  = !restart || !std::ifstream(file_name).good();
+
+  telemetry_file.open(file_name, new_file ? std::ios::trunc : std::ios::app);
+  AssertThrow(telemetry_file, ExcMessage("Cannot open the telemetry file " + file_name));
+
+  if (new_file && settings.telemetry_format == HeatNonLinearSettings::TelemetryFormat::csv)
+    telemetry_file << "timestep,time,deltat,accepted,newton_iterations,residual_norms,"
+                      "linear_iterations,preconditioner_time,assembly_time,solve_time,"
+                      "output_time"
+                   << std::endl;
+}
+
+template <int dim, unsigned int degree>
+void
+HeatNonLinear<dim, degree>::write_telemetry(const unsigned int &time_step,
+                                            const double       &step_time,
+                                            const double       &step_deltat,
+                                            const bool         &accepted) {
+    if (telemetry_file.is_open()) {
+      const StepTelemetry &t = step_telemetry;
+
+      telemetry_file << std::defaultfloat << std::setprecision(12);
+
+        if (settings.telemetry_format == HeatNonLinearSettings::TelemetryFormat::csv) {
+          telemetry_file << time_step << "," << step_time << "," << step_deltat << ","
+                         << accepted << "," << t.newton_iterations << ",";
+          for (unsigned int k = 0; k < t.residual_norms.size(); ++k)
+            telemetry_file << (k > 0 ? ";" : "") << t.residual_norms[k];
+          telemetry_file << "," << t.linear_iterations << "," << t.preconditioner_time << ","
+                         << t.assembly_time << "," << t.solve_time << "," << t.output_time;
+        } else {
+          telemetry_file << "{\"timestep\": " << time_step << ", \"time\": " << step_time
+                         << ", \"deltat\": " << step_deltat
+                         << ", \"accepted\": " << (accepted ? "true" : "false")
+                         << ", \"newton_iterations\": " << t.newton_iterations
+                         << ", \"residual_norms\": [";
+          for (unsigned int k = 0; k < t.residual_norms.size(); ++k)
+            telemetry_file << (k > 0 ? ", " : "") << t.residual_norms[k];
+          telemetry_file << "], \"linear_iterations\": " << t.linear_iterations
+                         << ", \"preconditioner_time\": " << t.preconditioner_time
+                         << ", \"assembly_time\": " << t.assembly_time
+                         << ", \"solve_time\": " << t.solve_time
+                         << ", \"output_time\": " << t.output_time << "}";
+        }
+
+      // Lines are flushed by the stream buffer, not one by one.
+      telemetry_file << '\n';
+    }
+
+  step_telemetry = StepTelemetry();
+}
+
+template <int dim, unsigned int degree>
+void
+HeatNonLinear<dim, degree>::write_analytics(const unsigned int &time_step) {
+  SectionScope section(*this, "Analytics");
+
+  const unsigned int n_q          = quadrature->size();
+  const unsigned int n_thresholds = settings.analytics_thresholds.size();
+
+  FEValues<dim> fe_values(*fe,
+                          *quadrature,
+                          update_values | update_quadrature_points | update_JxW_values);
+  std::vector<double> solution_loc(n_q);
+
+  // Sums: volume, integral of u and volume above each threshold. Maxima: max
+  // u, -min u, and the upper and (negated) lower corners of the bounding box
+  // of the front.
+  const unsigned int  n_sums = 2 + n_thresholds;
+  std::vector<double> values(1 + n_sums + 2 + 2 * dim, -std::numeric_limits<double>::max());
+  values[0] = n_sums;
+  std::fill(values.begin() + 1, values.begin() + 1 + n_sums, 0.0);
+
+  double *volume   = &values[1];
+  double *integral = &values[2];
+  double *above    = &values[3];
+  double *maximum  = &values[1 + n_sums];
+  double *corners  = &values[1 + n_sums + 2];
+
+    for (const auto &cell : dof_handler.active_cell_iterators()) {
+      if (!cell->is_locally_owned())
+        continue;
+
+      fe_values.reinit(cell);
+      fe_values.get_function_values(solution, solution_loc);
+
+        for (unsigned int q = 0; q < n_q; ++q) {
+          const double JxW = fe_values.JxW(q);
+
+          *volume += JxW;
+          *integral += solution_loc[q] * JxW;
+
+          for (unsigned int k = 0; k < n_thresholds; ++k)
+            if (solution_loc[q] > settings.analytics_thresholds[k])
+              above[k] += JxW;
+
+            if (solution_loc[q] > settings.front_threshold) {
+              const Point<dim> &p = fe_values.quadrature_point(q);
+
+                for (unsigned int d = 0; d < dim; ++d) {
+                  corners[d]       = std::max(corners[d], p[d]);
+                  corners[dim + d] = std::max(corners[dim + d], -p[d]);
+                }
+            }
+        }
+    }
+
+  // Nodal extrema, which bound the finite element function for P1.
+    for (const auto &u : solution_owned) {
+      maximum[0] = std::max(maximum[0], u);
+      maximum[1] = std::max(maximum[1], -u);
+    }
+
+  // All the quantities in one reduction.
+  MPI_Datatype type;
+  MPI_Type_contiguous(values.size(), MPI_DOUBLE, &type);
+  MPI_Type_commit(&type);
+  MPI_Op op;
+  MPI_Op_create(&reduce_sums_and_maxima, /*commute = */ 1, &op);
+
+  std::vector<double> result(values.size());
+  MPI_Reduce(values.data(), result.data(), 1, type, op, 0, mpi_comm);
+
+  MPI_Op_free(&op);
+  MPI_Type_free(&type);
+
+  if (mpi_rank != 0)
+    return;
+
+  const double *sums_result   = &result[1];
+  const double *maxima_result = &result[1 + n_sums];
+
+  // An empty front has its corners at -max.
+  const double *corners_result = &maxima_result[2];
+  double        front_extent   = 0.0;
+  if (corners_result[0] + corners_result[dim] >= 0.0)
+    for (unsigned int d = 0; d < dim; ++d)
+      front_extent += std::pow(corners_result[d] + corners_result[dim + d], 2);
+  front_extent = std::sqrt(front_extent);
+
+  // A new run starts a new file, a restarted one appends to it once solve()
+  // has dropped the rows after the checkpoint.
+  const std::string file_name = run_file_name(settings.analytics_file_name);
+
+  const bool    new_file = (time_step == 0 || !std::ifstream(file_name).good());
+  std::ofstream file(file_name, new_file ? std::ios::trunc : std::ios::app);
+
+    if (new_file) {
+      file << "timestep,time,integral,min,max";
+      for (const double &threshold : settings.analytics_thresholds)
+        file << ",volume_fraction_" << threshold;
+      file << ",front_extent" << std::endl;
+    }
+
+  file << std::defaultfloat << std::setprecision(12) << time_step << "," << time << ","
+       << sums_result[1] << "," << -maxima_result[1] << "," << maxima_result[0];
+  for (unsigned int k = 0; k < n_thresholds; ++k)
+    file << "," << sums_result[2 + k] / sums_result[0];
+  file << "," << front_extent << std::endl;
+}
+
+template <int dim, unsigned int degree>
+void
+HeatNonLinear<dim, degree>::adapt_mesh_to_front() {
+  // The output jobs still read the DoF handler.
+  finish_output();
+
+  SectionScope section(*this, "Mesh adaptation");
+
+  const unsigned int n_q            = quadrature->size();
+  const unsigned int n_original     = original_mesh.n_cells();
+  const unsigned int n_old_vertices = front_mesh.n_vertices();
+
+  FEValues<dim> fe_values(*fe, *quadrature, update_gradients | update_JxW_values);
+  std::vector<Tensor<1, dim>> solution_gradient_loc(n_q);
+
+  // Indicator of the owned cells, with the cell of the original mesh they
+  // are part of.
+  std::vector<std::pair<double, types::coarse_cell_id>> indicator;
+  indicator.reserve(mesh.n_locally_owned_active_cells());
+
+    for (const auto &cell : dof_handler.active_cell_iterators()) {
+      if (!cell->is_locally_owned())
+        continue;
+
+      fe_values.reinit(cell);
+      fe_values.get_function_gradients(solution, solution_gradient_loc);
+
+      double gradient_norm_square = 0.0;
+      for (unsigned int q = 0; q < n_q; ++q)
+        gradient_norm_square += solution_gradient_loc[q].norm_square() * fe_values.JxW(q);
+
+      indicator.emplace_back(cell->diameter() * std::sqrt(gradient_norm_square),
+                             original_cell_id(cell));
+    }
+
+  double max_indicator = 0.0;
+  for (const auto &[eta, id] : indicator)
+    max_indicator = std::max(max_indicator, eta);
+  max_indicator = Utilities::MPI::max(max_indicator, mpi_comm);
+
+  // Original cells with a part on the front, then those with a part that is
+  // not flat.
+  std::vector<unsigned char> flags(2 * n_original, 0);
+    for (const auto &[eta, id] : indicator) {
+      if (eta > settings.front_fraction * max_indicator)
+        flags[id] = 1;
+      if (eta >= settings.flat_fraction * max_indicator)
+        flags[n_original + id] = 1;
+    }
+
+  MPI_Allreduce(MPI_IN_PLACE, flags.data(), flags.size(), MPI_UNSIGNED_CHAR, MPI_MAX, mpi_comm);
+
+  std::vector<bool> front(n_original);
+  for (unsigned int c = 0; c < n_original; ++c)
+    front[c] = flags[c] > 0;
+
+  // The front does not leave the refined region before the next adaptation.
+  std::vector<bool> marked = original_mesh.vertex_neighbors(front);
+  for (unsigned int c = 0; c < n_original; ++c)
+    if (refined_cells[c] && flags[n_original + c] > 0)
+      marked[c] = true;
+
+  // The solution and the previous ones kept by the time scheme, which are
+  // moved to the new mesh through their vertex values.
+  std::vector<TrilinosWrappers::MPI::Vector *> history = {&solution_owned, &solution_old_owned};
+  if (solution_older_owned.size() > 0)
+    history.push_back(&solution_older_owned);
+  if (time_derivative_owned.size() > 0)
+    history.push_back(&time_derivative_owned);
+
+  std::vector<double> old_values(history.size() * n_old_vertices,
+                                 std::numeric_limits<double>::lowest());
+  TrilinosWrappers::MPI::Vector ghosted(locally_owned_dofs, locally_relevant_dofs, mpi_comm);
+
+    for (unsigned int k = 0; k < history.size(); ++k) {
+      update_ghost_values(ghosted, *history[k]);
+
+        for (const auto &cell : dof_handler.active_cell_iterators()) {
+          if (!cell->is_locally_owned())
+            continue;
+
+          const auto &vertices = front_mesh.cell(cell->id().get_coarse_cell_id());
+          for (unsigned int v = 0; v < cell->n_vertices(); ++v)
+            old_values[k * n_old_vertices + vertices[v]] = ghosted(cell->vertex_dof_index(v, 0));
+        }
+    }
+
+  // Every vertex belongs to a cell owned by some process.
+  MPI_Allreduce(
+    MPI_IN_PLACE, old_values.data(), old_values.size(), MPI_DOUBLE, MPI_MAX, mpi_comm);
+
+  SimplexMesh<dim> new_mesh = original_mesh.refine(marked, settings.front_bisections);
+
+  std::vector<std::vector<double>> new_values(history.size());
+  for (unsigned int k = 0; k < history.size(); ++k)
+    new_values[k] = new_mesh.interpolate(
+      front_mesh,
+      std::vector<double>(old_values.begin() + k * n_old_vertices,
+                          old_values.begin() + (k + 1) * n_old_vertices));
+
+    {
+      const TriangulationDescription::Description<dim> construction_data =
+        new_mesh.create_description(new_mesh.partition(mpi_size, mpi_comm), mpi_comm);
+
+      // A mesh cannot be cleared while a DoF handler uses it.
+      Triangulation<dim> placeholder;
+      dof_handler.reinit(placeholder);
+      mesh.clear();
+      mesh.create_triangulation(construction_data);
+      dof_handler.reinit(mesh);
+    }
+
+  front_mesh    = std::move(new_mesh);
+  refined_cells = marked;
+
+  // The setup reports are printed once, by setup().
+  pcout.set_condition(false);
+  setup_system();
+  pcout.set_condition(mpi_rank == 0);
+
+    for (unsigned int k = 0; k < history.size(); ++k) {
+      TrilinosWrappers::MPI::Vector &vector = *history[k];
+      vector.reinit(locally_owned_dofs, mpi_comm);
+
+        for (const auto &cell : dof_handler.active_cell_iterators()) {
+          if (!cell->is_locally_owned())
+            continue;
+
+          const auto &vertices = front_mesh.cell(cell->id().get_coarse_cell_id());
+            for (unsigned int v = 0; v < cell->n_vertices(); ++v) {
+              const types::global_dof_index i = cell->vertex_dof_index(v, 0);
+              if (locally_owned_dofs.is_element(i))
+                vector[i] = new_values[k][vertices[v]];
+            }
+        }
+
+      vector.compress(VectorOperation::insert);
+    }
+
+  update_ghost_values(solution, solution_owned);
+
+  // Nothing laid out for the old DoFs can be reused.
+  jacobian_operator.clear();
+  for (OutputJob &job : output_jobs)
+    job.solution.clear();
+  if (output_writer)
+    output_writer->change_mesh();
+
+  jacobian_outdated        = true;
+  ssor_outdated            = true;
+  amg_outdated             = true;
+  amg_reference_iterations = 0;
+
+  const unsigned int n_refined = std::count(marked.begin(), marked.end(), true);
+
+  pcout_steps << "  Mesh adapted to the front: " << n_refined << "/" << n_original
+              << " cells refined, " << mesh.n_global_active_cells() << " cells, "
+              << dof_handler.n_dofs() << " DoFs" << std::endl;
+}
+
+template <int dim, unsigned int degree>
+void
+HeatNonLinear<dim, degree>::solve_adaptive(TimeLoopState &state) {
+  AssertThrow(settings.splitting == HeatNonLinearSettings::Splitting::none,
+              ExcMessage("Adaptive time stepping needs the monolithic scheme."));
+  AssertThrow(settings.time_scheme == HeatNonLinearSettings::TimeScheme::backward_euler,
+              ExcMessage("The error estimate of adaptive time stepping is that of "
+                         "backward Euler."));
+
+  // Solution at the step before the previous one (restored by a restart),
+  // and predictor obtained by linear extrapolation of the last two steps.
+  solution_older_owned = solution_old_owned;
+  TrilinosWrappers::MPI::Vector predictor(locally_owned_dofs, mpi_comm);
+
+  // Scratch vectors for the error estimate and the interpolated outputs.
+  TrilinosWrappers::MPI::Vector error_estimate(locally_owned_dofs, mpi_comm);
+  TrilinosWrappers::MPI::Vector output_owned(locally_owned_dofs, mpi_comm);
+  TrilinosWrappers::MPI::Vector output_vector(locally_owned_dofs,
+                                              locally_relevant_dofs,
+                                              mpi_comm);
+
+  // Exponents of the PI controller for a first order method (k = 2).
+  const double k_I = 0.7 / 2.0;
+  const double k_P = 0.4 / 2.0;
+
+  unsigned int n_rejected = 0;
+
+  deltat = std::min(std::max(deltat, settings.min_time_step), settings.max_time_step);
+
+    while (time < T - 0.5 * settings.min_time_step) {
+      // Do not step past the final time.
+      deltat = std::min(deltat, T - time);
+
+      // Store the old solution, so that it is available for assembly.
+      solution_old_owned = solution_owned;
+
+        // Linear extrapolation from the last two steps, used both as the
+        // initial guess of Newton's method and as the embedded lower order
+        // solution for the error estimate.
+        if (state.time_step > 0) {
+          predictor = solution_old_owned;
+          predictor -= solution_older_owned;
+          predictor.sadd(deltat / state.deltat_previous, 1.0, solution_old_owned);
+
+          solution_owned = predictor;
+          update_ghost_values(solution, solution_owned);
+        }
+
+      pcout_steps << "n = " << std::setw(3) << state.time_step + 1 << ", t = " << std::setw(5)
+                  << std::fixed << time + deltat << ", dt = " << std::scientific << deltat
+                  << std::endl;
+
+      const bool converged = solve_time_step(state.time_step + 1);
+
+        // Without convergence there is no solution to estimate the error of:
+        // retry with a smaller step.
+        if (!converged) {
+          AssertThrow(deltat > settings.min_time_step,
+                      ExcMessage("Newton's method did not converge with the minimum "
+                                 "time step."));
+
+          write_telemetry(state.time_step + 1, time + deltat, deltat, false);
+
+          solution_owned = solution_old_owned;
+          update_ghost_values(solution, solution_owned);
+
+          deltat = std::max(settings.min_time_step, 0.25 * deltat);
+          ++n_rejected;
+
+          pcout_steps << "  step rejected, Newton's method did not converge" << std::endl
+                      << std::endl;
+          continue;
+        }
+
+      // Local truncation error of backward Euler (Milne's device): with the
+      // extrapolated predictor, LTE = dt / (2 dt + dt_old) (u - u_pred). The
+      // first step has no predictor and is always accepted.
+      double error_norm = 0.0;
+
+        if (state.time_step > 0) {
+          error_estimate = solution_owned;
+          error_estimate -= predictor;
+
+          error_norm = error_estimate.linfty_norm() * deltat /
+                       (2.0 * deltat + state.deltat_previous) /
+                       (settings.time_absolute_tolerance +
+                        settings.time_relative_tolerance * solution_owned.linfty_norm());
+        }
+
+        if (error_norm > 1.0 && deltat > settings.min_time_step) {
+          write_telemetry(state.time_step + 1, time + deltat, deltat, false);
+
+          // Reject the step and retry from the old solution.
+          solution_owned = solution_old_owned;
+          update_ghost_values(solution, solution_owned);
+
+          deltat = std::max(settings.min_time_step,
+                            deltat * std::max(0.2, 0.9 * std::pow(error_norm, -0.5)));
+          ++n_rejected;
+
+          pcout_steps << "  step rejected, error = " << std::scientific << error_norm
+                      << std::endl
+                      << std::endl;
+          continue;
+        }
+
+        // Output at the requested times, interpolating linearly within the
+        // step.
+        while (settings.output_interval > 0 && state.next_output <= time + deltat) {
+          const double theta = (state.next_output - time) / deltat;
+
+          enter_section("Writing");
+          output_owned = solution_old_owned;
+          output_owned.sadd(1.0 - theta, theta, solution_owned);
+          update_ghost_values(output_vector, output_owned);
+          output(state.n_output, state.next_output, output_vector);
+          leave_section();
+
+          ++state.n_output;
+          state.next_output += settings.output_interval;
+        }
+
+      solution_older_owned  = solution_old_owned;
+      state.deltat_previous = deltat;
+      time += deltat;
+      ++state.time_step;
+
+      if (!settings.analytics_file_name.empty())
+        write_analytics(state.time_step);
+
+        // PI controller on the normalized error.
+        if (state.time_step > 1) {
+          error_norm = std::max(error_norm, 1e-10);
+
+          const double factor = 0.9 * std::pow(error_norm, -k_I) *
+                                std::pow(state.error_norm_old / error_norm, k_P);
+
+          deltat *= std::min(5.0, std::max(0.2, factor));
+          deltat = std::min(std::max(deltat, settings.min_time_step),
+                            settings.max_time_step);
+
+          state.error_norm_old = error_norm;
+        }
+
+        if (settings.front_interval > 0 && state.time_step % settings.front_interval == 0) {
+          adapt_mesh_to_front();
+          output_vector.reinit(locally_owned_dofs, locally_relevant_dofs, mpi_comm);
+        }
+
+      if (settings.checkpoint_interval > 0 &&
+          state.time_step % settings.checkpoint_interval == 0)
+        write_checkpoint(state, solution_older_owned);
+
+      write_telemetry(state.time_step, time, state.deltat_previous, true);
+
+      pcout_steps << std::endl;
+    }
+
+  pcout << "===============================================" << std::endl;
+  pcout << state.time_step << " accepted steps, " << n_rejected << " rejected steps"
+        << std::endl;
+}
+
+template <int dim, unsigned int degree>
+void
+HeatNonLinear<dim, degree>::write_checkpoint(
+  const TimeLoopState                 &state,
+  const TrilinosWrappers::MPI::Vector &previous_solution_owned) {
+  // The outputs up to this step are on disk before the checkpoint is, since a
+  // restart from it does not write them again.
+  finish_output();
+
+  SectionScope section(*this, "Checkpoint");
+
+  const std::string file_name = run_file_name(settings.checkpoint_prefix) + "-" +
+                                std::to_string(n_checkpoints % settings.checkpoint_copies) +
+                                ".bin";
+  ++n_checkpoints;
+
+  // Every record holds the cell values of the solution, of the previous one
+  // and, for the theta method past its first step, of the time derivative.
+  const unsigned int dofs_per_cell = fe->dofs_per_cell;
+  const unsigned int n_fields      = time_derivative_available ? 3 : 2;
+  const unsigned int record_size   = n_fields * dofs_per_cell;
+
+  std::vector<TrilinosWrappers::MPI::Vector> fields(n_fields - 1);
+  fields[0].reinit(locally_owned_dofs, locally_relevant_dofs, mpi_comm);
+  update_ghost_values(fields[0], previous_solution_owned);
+    if (time_derivative_available) {
+      fields[1].reinit(locally_owned_dofs, locally_relevant_dofs, mpi_comm);
+      update_ghost_values(fields[1], time_derivative_owned);
+    }
+
+  const auto cells = owned_cells_by_coarse_id(dof_handler);
+
+  std::vector<double> buffer(cells.size() * record_size);
+  Vector<double>      cell_values(dofs_per_cell);
+
+    for (unsigned int c = 0; c < cells.size(); ++c) {
+      cells[c].second->get_dof_values(solution, cell_values);
+      std::copy(cell_values.begin(), cell_values.end(), &buffer[c * record_size]);
+
+        for (unsigned int k = 1; k < n_fields; ++k) {
+          cells[c].second->get_dof_values(fields[k - 1], cell_values);
+          std::copy(cell_values.begin(),
+                    cell_values.end(),
+                    &buffer[c * record_size + k * dofs_per_cell]);
+        }
+    }
+
+  const CheckpointHeader header = {checkpoint_magic,
+                                   checkpoint_version,
+                                   mesh.n_global_active_cells(),
+                                   dofs_per_cell,
+                                   state.time_step,
+                                   state.n_output,
+                                   time,
+                                   deltat,
+                                   state.next_output,
+                                   state.deltat_previous,
+                                   state.error_norm_old,
+                                   time_derivative_available};
+
+  // The file only replaces the previous checkpoint of the same slot once it
+  // is complete.
+  const std::string partial_file_name = file_name + ".partial";
+
+  MPI_File file;
+  int      ierr = MPI_File_open(mpi_comm,
+                           partial_file_name.c_str(),
+                           MPI_MODE_CREATE | MPI_MODE_WRONLY,
+                           MPI_INFO_NULL,
+                           &file);
+  AssertThrowMPI(ierr);
+  MPI_File_set_size(file, 0);
+
+  if (mpi_rank == 0)
+    MPI_File_write_at(file, 0, &header, sizeof(header), MPI_BYTE, MPI_STATUS_IGNORE);
+
+  MPI_Datatype view = make_checkpoint_view<dim>(cells, record_size);
+  MPI_File_set_view(file, sizeof(header), MPI_DOUBLE, view, "native", MPI_INFO_NULL);
+  ierr = MPI_File_write_all(
+    file, buffer.data(), buffer.size(), MPI_DOUBLE, MPI_STATUS_IGNORE);
+  AssertThrowMPI(ierr);
+
+  MPI_File_close(&file);
+  MPI_Type_free(&view);
+
+  if (mpi_rank == 0)
+    std::rename(partial_file_name.c_str(), file_name.c_str());
+
+  // The run goes on as a restart from this checkpoint does: with the Jacobian
+  // and the preconditioners rebuilt, and the linear solver starting from zero.
+  jacobian_outdated        = true;
+  ssor_outdated            = true;
+  amg_outdated             = true;
+  amg_reference_iterations = 0;
+  delta_owned              = 0.0;
+
+  pcout_steps << "  Checkpoint written to " << file_name << std::endl;
+}
+
+template <int dim, unsigned int degree>
+void
+HeatNonLinear<dim, degree>::read_checkpoint(TimeLoopState &state) {
+  SectionScope section(*this, "Checkpoint");
+
+  MPI_File file;
+  int      ierr = MPI_File_open(
+    mpi_comm, settings.restart_file.c_str(), MPI_MODE_RDONLY, MPI_INFO_NULL, &file);
+  AssertThrowMPI(ierr);
+
+  CheckpointHeader header;
+  MPI_File_read_at_all(file, 0, &header, sizeof(header), MPI_BYTE, MPI_STATUS_IGNORE);
+
+  AssertThrow(header.magic == checkpoint_magic && header.version == checkpoint_version,
+              ExcMessage(settings.restart_file + " is not a checkpoint of this version."));
+
+  const unsigned int dofs_per_cell = fe->dofs_per_cell;
+  const unsigned int n_fields      = header.has_time_derivative ? 3 : 2;
+  const unsigned int record_size   = n_fields * dofs_per_cell;
+
+  AssertThrow(header.n_cells == mesh.n_global_active_cells() &&
+                header.dofs_per_cell == dofs_per_cell,
+              ExcMessage("The checkpoint was written for a different mesh or degree."));
+  AssertThrow(!header.has_time_derivative ||
+                settings.time_scheme == HeatNonLinearSettings::TimeScheme::theta,
+              ExcMessage("The checkpoint was written for the theta method."));
+
+  const auto cells = owned_cells_by_coarse_id(dof_handler);
+
+  std::vector<double> buffer(cells.size() * record_size);
+
+  MPI_Datatype view = make_checkpoint_view<dim>(cells, record_size);
+  MPI_File_set_view(file, sizeof(header), MPI_DOUBLE, view, "native", MPI_INFO_NULL);
+  ierr =
+    MPI_File_read_all(file, buffer.data(), buffer.size(), MPI_DOUBLE, MPI_STATUS_IGNORE);
+  AssertThrowMPI(ierr);
+
+  MPI_File_close(&file);
+  MPI_Type_free(&view);
+
+  if (header.has_time_derivative)
+    time_derivative_owned.reinit(locally_owned_dofs, mpi_comm);
+
+  std::vector<types::global_dof_index> dof_indices(dofs_per_cell);
+
+    for (unsigned int c = 0; c < cells.size(); ++c) {
+      cells[c].second->get_dof_indices(dof_indices);
+
+        for (unsigned int i = 0; i < dofs_per_cell; ++i) {
+          if (!locally_owned_dofs.is_element(dof_indices[i]))
+            continue;
+
+          solution_owned[dof_indices[i]]     = buffer[c * record_size + i];
+          solution_old_owned[dof_indices[i]] = buffer[c * record_size + dofs_per_cell + i];
+          if (header.has_time_derivative)
+            time_derivative_owned[dof_indices[i]] =
+              buffer[c * record_size + 2 * dofs_per_cell + i];
+        }
+    }
+
+  solution_owned.compress(VectorOperation::insert);
+  solution_old_owned.compress(VectorOperation::insert);
+    if (header.has_time_derivative) {
+      time_derivative_owned.compress(VectorOperation::insert);
+      time_derivative_available = true;
+    }
+
+  update_ghost_values(solution, solution_owned);
+
+  time   = header.time;
+  deltat = header.deltat;
+
+  state.time_step       = header.time_step;
+  state.n_output        = header.n_output;
+  state.next_output     = header.next_output;
+  state.deltat_previous = header.deltat_previous;
+  state.error_norm_old  = header.error_norm_old;
+}
+
+template <int dim, unsigned int degree>
+void
+HeatNonLinear<dim, degree>::solve() {
+  pcout << "===============================================" << std::endl;
+
+  time     = 0.0;
+  n_newton = 0;
+  n_linear = 0;
+
+  time_derivative_available = false;
+
+  TimeLoopState state;
+  state.next_output = settings.output_interval;
+
+  // The output of the previous run, if any, was completed by finish_run().
+  output_writer = std::make_unique<TimeSeriesWriter<dim>>(run_file_name(settings.output_prefix),
+                                                          settings.output_compression,
+                                                          mpi_comm,
+                                                          !settings.restart_file.empty());
+
+    if (!settings.restart_file.empty()) {
+      pcout << "Restarting from " << settings.restart_file << std::endl;
+
+      read_checkpoint(state);
+
+        // The logs go on from the checkpoint.
+        if (mpi_rank == 0) {
+          if (!settings.analytics_file_name.empty())
+            truncate_log(run_file_name(settings.analytics_file_name), state.time_step);
+          if (!settings.telemetry_file_name.empty())
+            truncate_log(run_file_name(settings.telemetry_file_name), state.time_step);
+        }
+
+      pcout << "  n = " << state.time_step << ", t = " << time << std::endl;
+      pcout << "-----------------------------------------------" << std::endl;
+    } else {
+      // Apply the initial condition.
+      pcout << "Applying the initial condition" << std::endl;
+
+      VectorTools::interpolate(dof_handler, u_0, solution_owned);
+      update_ghost_values(solution, solution_owned);
+
+        // The mesh starts adapted to the seed, which is then interpolated
+        // again.
+        if (settings.front_interval > 0) {
+          adapt_mesh_to_front();
+          VectorTools::interpolate(dof_handler, u_0, solution_owned);
+          update_ghost_values(solution, solution_owned);
+        }
+
+      // Output the initial solution.
+      enter_section("Writing");
+      if (settings.output_interval > 0)
+        output(0, 0.0);
+      leave_section();
+
+      if (!settings.analytics_file_name.empty())
+        write_analytics(0);
+      pcout << "-----------------------------------------------" << std::endl;
+    }
+
+  // The initial output is not part of the first step.
+  open_telemetry(!settings.restart_file.empty());
+  step_telemetry = StepTelemetry();
+
+    if (settings.time_stepping == HeatNonLinearSettings::TimeStepping::adaptive) {
+      solve_adaptive(state);
+      finish_run(state);
+      return;
+    }
+
+    while (time < T - 0.5 * deltat) {
+      time += deltat;
+      ++state.time_step;
+
+      // Store the old solutions, so that they are available for assembly.
+      if (settings.time_scheme == HeatNonLinearSettings::TimeScheme::bdf2)
+        solution_older_owned = solution_old_owned;
+      solution_old_owned = solution_owned;
+
+      pcout_steps << "n = " << std::setw(3) << state.time_step << ", t = " << std::setw(5)
+                  << std::fixed << time << std::endl;
+
+      // At every time step, we invoke Newton's method to solve the non-linear
+      // stages of the time scheme, unless reaction and diffusion are split.
+      if (settings.splitting == HeatNonLinearSettings::Splitting::strang)
+        solve_splitting_step();
+      else if (!solve_time_step(state.time_step))
+        pcout << "  Newton's method did not converge at step " << state.time_step
+              << std::endl;
+
+      if (!settings.analytics_file_name.empty())
+        write_analytics(state.time_step);
+
+        if (settings.output_interval > 0 && time > state.next_output - 0.5 * deltat) {
+          enter_section("Writing");
+          output(state.n_output, time);
+          leave_section();
+
+          ++state.n_output;
+          state.next_output += settings.output_interval;
+        }
+
+      if (settings.front_interval > 0 && state.time_step % settings.front_interval == 0)
+        adapt_mesh_to_front();
+
+      if (settings.checkpoint_interval > 0 &&
+          state.time_step % settings.checkpoint_interval == 0)
+        write_checkpoint(state, solution_old_owned);
+
+      write_telemetry(state.time_step, time, deltat, true);
+
+      pcout_steps << std::endl;
+    }
+
+  finish_run(state);
+}
+
+template <int dim, unsigned int degree>
+void
+HeatNonLinear<dim, degree>::finish_run(const TimeLoopState &state) {
+  finish_output();
+  n_steps = state.time_step;
+  telemetry_file.close();
+
+  if (settings.load_balance_report)
+    report_load_balance(run_file_name(settings.load_balance_file_name));
+
+  if (settings.perf_counters)
+    report_hardware_counters();
+}
+
+template <int dim, unsigned int degree>
+void
+HeatNonLinear<dim, degree>::set_scenario(const HeatNonLinearScenario &scenario) {
+  run_name          = scenario.name;
+  alpha.coefficient = scenario.alpha;
+  d_ext             = scenario.d_ext;
+  d_axn             = scenario.d_axn;
+  axon_direction    = scenario.axon_direction;
+  T                 = scenario.T;
+  deltat            = scenario.deltat;
+
+  D = set_up_diffusivity(d_ext, d_axn);
+  set_up_regions();
+  set_seed(scenario);
+
+  // Before setup(), nothing depends on the coefficients yet.
+  if (dof_handler.n_dofs() == 0)
+    return;
+
+    // The cells missing from the fiber file take the diffusivity of their
+    // region, which has just changed.
+    if (!settings.fiber_file_name.empty()) {
+      enter_section("Read fiber file");
+      read_fiber_file();
+      leave_section();
+    }
+
+  if (settings.cache_geometry)
+    reinit_geometry_cache();
+
+    if (use_constant_matrices()) {
+      enter_section("Assemble constant matrices");
+      assemble_constant_matrices();
+      leave_section();
+    }
+
+  // Nothing can be reused from the previous run.
+  jacobian_outdated        = true;
+  ssor_outdated            = true;
+  amg_outdated             = true;
+  amg_reference_iterations = 0;
+}
+
+template <int dim, unsigned int degree>
+double
+HeatNonLinear<dim, degree>::integral() const {
+  const unsigned int n_q = quadrature->size();
+
+  FEValues<dim> fe_values(*fe, *quadrature, update_values | update_JxW_values);
+  std::vector<double> solution_loc(n_q);
+
+  double result = 0.0;
+
+    for (const auto &cell : dof_handler.active_cell_iterators()) {
+      if (!cell->is_locally_owned())
+        continue;
+
+      fe_values.reinit(cell);
+      fe_values.get_function_values(solution, solution_loc);
+
+      for (unsigned int q = 0; q < n_q; ++q)
+        result += solution_loc[q] * fe_values.JxW(q);
+    }
+
+  return Utilities::MPI::sum(result, mpi_comm);
+}
+
+// The dimensions and degrees the drivers are built for (1D and 2D from
+// deal.II 9.4 on, see CMakeLists.txt).
+#if DEAL_II_VERSION_GTE(9, 4, 0)
+template class HeatNonLinear<1, 1>;
+template class HeatNonLinear<1, 2>;
+template class HeatNonLinear<2, 1>;
+template class HeatNonLinear<2, 2>;
+#endif
+template class HeatNonLinear<3, 1>;
+template class HeatNonLinear<3, 2>;
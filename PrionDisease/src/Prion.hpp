@@ -2,8 +2,16 @@
 #define PRION_HPP
 
 #include <deal.II/base/conditional_ostream.h>
+#include <deal.II/base/memory_consumption.h>
+#include <deal.II/base/multithread_info.h>
+#include <deal.II/base/parallel.h>
+#include <deal.II/base/partitioner.h>
 #include <deal.II/base/quadrature_lib.h>
+#include <deal.II/base/symmetric_tensor.h>
 #include <deal.II/base/timer.h>
+#include <deal.II/base/utilities.h>
+#include <deal.II/base/vectorization.h>
+#include <deal.II/base/work_stream.h>
 
 #include <deal.II/distributed/fully_distributed_tria.h>
 
@@ -16,11 +24,14 @@
 #include <deal.II/fe/fe_values_extractors.h>
 #include <deal.II/fe/mapping_fe.h>
 
+#include <deal.II/grid/filtered_iterator.h>
 #include <deal.II/grid/grid_generator.h>
 #include <deal.II/grid/grid_in.h>
 #include <deal.II/grid/grid_out.h>
 #include <deal.II/grid/tria.h>
+#include <deal.II/grid/tria_description.h>
 
+#include <deal.II/lac/diagonal_matrix.h>
 #include <deal.II/lac/solver_cg.h>
 #include <deal.II/lac/solver_gmres.h>
 #include <deal.II/lac/trilinos_precondition.h>
@@ -30,24 +41,377 @@
 #include <deal.II/numerics/matrix_tools.h>
 #include <deal.II/numerics/vector_tools.h>
 
+#include <array>
 #include <fstream>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <thread>
+
+#include "GeometryCache.hpp"
+#include "MeshCache.hpp"
+#include "PerfCounters.hpp"
+#include "SimplexMesh.hpp"
+#include "TimeSeriesWriter.hpp"
 
 using namespace dealii;
 
-// Class representing the non-linear diffusion problem.
+// Coefficients of a region of the mesh (see HeatNonLinearSettings::regions).
+struct HeatNonLinearRegion {
+  double alpha = 2.0;
+  double d_ext = 10.0;
+  double d_axn = 0.0;
+};
+
+// Run-time options of HeatNonLinear. Every field has a default reproducing the
+// original behaviour, so that a driver only sets what it wants to change.
+struct HeatNonLinearSettings {
+  // Mesh file, relative to the working directory: either a Gmsh file or a
+  // mesh cache written by convert_mesh. If empty, the mesh is the unit
+  // hypercube split into simplices, with N + 1 subdivisions per side.
+  std::string mesh_file_name = "../mesh/half-brain.msh";
+
+  // How a Gmsh file is read and partitioned. A mesh cache is mapped by every
+  // process in both modes.
+  enum class MeshIngestion {
+    // Every process reads and partitions the whole mesh, and keeps its part.
+    every_process,
+    // One process per group reads and partitions the whole mesh, and sends
+    // the other processes of the group their part.
+    groups
+  };
+
+  MeshIngestion mesh_ingestion = MeshIngestion::every_process;
+
+  // Processes per group in group mode (0: the processes sharing a node).
+  unsigned int mesh_group_size = 0;
+
+  // Text file with the local fiber orientation, one line per cell:
+  //   coarse_cell_id axon_x axon_y axon_z d_ext d_axn
+  // giving the diffusivity d_ext I + d_axn a (x) a of the cell, with a the
+  // normalized axon direction. Missing cells use the diffusivity of their
+  // region (empty: the diffusivity of the regions everywhere).
+  std::string fiber_file_name;
+
+  // Time the FEValues assembly kernel during setup with the per-cell
+  // diffusivity of the fiber file and with a constant one, and print the
+  // overhead (a few extra assembly sweeps).
+  bool diffusivity_cost_report = false;
+
+  // Coefficients of the regions of the mesh, selected by the material id that
+  // the Gmsh physical volumes give to the cells, with the axon direction of
+  // the scenario. Cells of other materials use the coefficients of the
+  // scenario.
+  std::map<types::material_id, HeatNonLinearRegion> regions;
+
+  // Evaluate alpha through HeatNonLinear::FunctionAlpha at every quadrature
+  // node, for a reaction coefficient that varies in space, instead of looking
+  // it up once per cell from the regions. Only then are the quadrature nodes
+  // mapped.
+  bool spatial_alpha = false;
+
+  // How the Jacobian of the Newton linearization is handled.
+  enum class JacobianMode {
+    // Assemble the Jacobian into a Trilinos sparse matrix, preconditioned
+    // with SSOR.
+    assembled,
+    // Never store the Jacobian: its action is evaluated cell by cell at the
+    // quadrature nodes, and a Jacobi preconditioner is built from its
+    // diagonal.
+    matrix_free
+  };
+
+  JacobianMode jacobian_mode = JacobianMode::assembled;
+
+  // How the assembled Jacobian and the residual are built at every Newton
+  // iteration (ignored in matrix-free mode).
+  enum class Assembly {
+    // Integrate all terms over every cell.
+    full,
+    // Assemble the mass and stiffness matrices once in setup(), and only
+    // integrate the reaction term alpha M (1 - 2u) at every iteration.
+    precomputed,
+    // As precomputed, with the reaction term interpolated at the nodes and
+    // integrated with the lumped mass matrix (group formulation, P1 only):
+    // no quadrature loop is left in the Newton iterations.
+    precomputed_lumped
+  };
+
+  Assembly assembly = Assembly::full;
+
+  // Precompute JxW, mapped shape gradients, D grad(phi) and alpha at the
+  // quadrature nodes of the owned cells once, and stream through them in the
+  // full assembly and in the matrix-free operator instead of calling
+  // FEValues::reinit() on every cell at every Newton iteration.
+  bool cache_geometry = false;
+
+  // Assemble the cached cells in batches of VectorizedArray<double>::size(),
+  // with kernels whose loop bounds are known at compile time. Only P1 and P2
+  // have such a kernel, other degrees use the generic one (cache_geometry
+  // only, full assembly and matrix-free operator data).
+  bool vectorize_assembly = false;
+
+  // Threads per MPI process used by the cell loop of the full assembly
+  // (numbers::invalid_unsigned_int uses all the available cores).
+  unsigned int n_threads = 1;
+
+  // Preconditioner of the assembled Jacobian (ignored in matrix-free mode).
+  enum class Preconditioner {
+    // SSOR, rebuilt at every Newton iteration.
+    ssor,
+    // Trilinos AMG, kept across Newton iterations and time steps.
+    amg
+  };
+
+  Preconditioner preconditioner = Preconditioner::ssor;
+
+  // The AMG hierarchy is rebuilt when a CG solve takes more than this factor
+  // times the iterations of the first solve after the previous rebuild.
+  double amg_rebuild_factor = 1.5;
+
+  // Newton iterations stop when ||r|| is below the larger of the absolute
+  // tolerance and the relative one times the first residual of the time step.
+  unsigned int newton_max_iterations     = 1000;
+  double       newton_absolute_tolerance = 1e-10;
+  double       newton_relative_tolerance = 0.0;
+
+  // Relative tolerance of the linear solver at each Newton iteration.
+  enum class ForcingTerm {
+    // Always linear_tolerance.
+    constant,
+    // Eisenstat-Walker choice 2, starting from linear_tolerance.
+    eisenstat_walker
+  };
+
+  ForcingTerm forcing_term     = ForcingTerm::constant;
+  double      linear_tolerance = 1e-6;
+
+  // Parameters of the Eisenstat-Walker forcing term.
+  double eisenstat_walker_gamma    = 0.9;
+  double eisenstat_walker_exponent = 2.0;
+  double eisenstat_walker_max      = 0.9;
+
+  // Modified Newton: keep the Jacobian and its preconditioner across
+  // iterations and time steps, and refresh them when an iteration reduces
+  // the residual by less than jacobian_refresh_contraction.
+  bool   lag_jacobian                 = false;
+  double jacobian_refresh_contraction = 0.5;
+
+  // Treatment of the reaction and diffusion terms within a time step.
+  enum class Splitting {
+    // Both terms in one non-linear system, solved with Newton's method.
+    none,
+    // Strang splitting: exact node-wise logistic reaction over half steps,
+    // around a Crank-Nicolson diffusion step whose matrix and preconditioner
+    // are built once (assembled Jacobian and fixed time step only).
+    strang
+  };
+
+  Splitting splitting = Splitting::none;
+
+  // Implicit time integration scheme of the monolithic problem M du/dt =
+  // F(u), with F the weak diffusion and reaction terms. Every scheme solves
+  // one or more stages M (u - w) / tau = F(u) with Newton's method, w being a
+  // combination of known vectors and tau a fraction of the time step.
+  enum class TimeScheme {
+    // First order, L-stable: one stage with w = u n and tau = deltat.
+    backward_euler,
+    // Second order BDF at fixed time step, L-stable: one stage with w = (4 u n
+    // - u n-1) / 3 and tau = 2 deltat / 3. The first step of a run uses
+    // backward Euler.
+    bdf2,
+    // Theta method with theta = time_theta (Crank-Nicolson for 0.5): one
+    // stage with tau = theta deltat. Second order for 0.5 but not L-stable.
+    // The first step of a run uses backward Euler, which also damps the
+    // oscillations of Crank-Nicolson on a steep seed; a restart resumes with
+    // the time derivative stored in the checkpoint.
+    theta,
+    // Two-stage, second order L-stable SDIRK of Alexander.
+    sdirk2,
+    // Three-stage, third order L-stable SDIRK of Alexander.
+    sdirk3
+  };
+
+  TimeScheme time_scheme = TimeScheme::backward_euler;
+
+  // Parameter of the theta method, between 0.5 and 1 (1: backward Euler).
+  double time_theta = 0.5;
+
+  // Time step selection.
+  enum class TimeStepping {
+    // Constant time step, as given to the constructor.
+    fixed,
+    // Time step chosen by a PI controller on an embedded estimate of the
+    // local error, starting from the one given to the constructor. The
+    // estimate is that of backward Euler, so the other schemes (BDF2
+    // included) are rejected. Steps where Newton's method does not converge
+    // are rejected and retried with a quarter of the time step.
+    adaptive
+  };
+
+  TimeStepping time_stepping = TimeStepping::fixed;
+
+  // Local error tolerances of the adaptive time stepping, in the maximum norm.
+  double time_absolute_tolerance = 1e-4;
+  double time_relative_tolerance = 1e-3;
+
+  // Bounds on the adaptive time step.
+  double min_time_step = 1e-4;
+  double max_time_step = 10.0;
+
+  // Simulated time between two outputs (0 disables the output). With
+  // adaptive time stepping, outputs are interpolated at exact multiples.
+  double output_interval = 0.0;
+
+  // Build the output patches of a snapshot of the solution in a background
+  // thread while the time loop goes on. The file is written at the next
+  // output, before a checkpoint or a mesh adaptation, or at the end of the
+  // run. The write itself is collective and stays on the main thread, as
+  // deal.II initializes MPI for serialized calls only.
+  bool asynchronous_output = false;
+
+  // The output goes to <output_prefix>.h5 and <output_prefix>.xdmf (prefixed
+  // with the scenario name, if any), with the given deflate level (0 to 9, 0
+  // disables compression). A restarted run appends to them, dropping the
+  // snapshots written after its checkpoint; on another number of processes,
+  // its snapshots go on a new copy of the mesh in the same file.
+  std::string  output_prefix      = "output";
+  unsigned int output_compression = 0;
+
+  // Time steps between two adaptations of the mesh to the front (0 keeps the
+  // mesh read by setup(); P1 only, without checkpoints). The mesh is rebuilt
+  // from the one read by setup() by bisecting front_bisections times the
+  // cells near the front (dim bisections about halve the mesh size), so that
+  // the cells left behind by the front go back to their original size, and
+  // it is partitioned again. A cell of the original mesh is near the front if
+  // the gradient indicator h_K ||grad u||_K of one of its parts, or of the
+  // parts of a cell sharing a vertex with it, exceeds front_fraction times its
+  // maximum; once refined, it stays so until the indicator of all its parts
+  // is below flat_fraction times the maximum. The solution and the previous
+  // ones are interpolated on the new mesh, which is exact for P1.
+  unsigned int front_interval   = 0;
+  unsigned int front_bisections = 3;
+  double       front_fraction   = 0.1;
+  double       flat_fraction    = 1e-3;
+
+  // CSV file receiving, after every accepted time step, the integral of u,
+  // its extrema, the fraction of the volume where u exceeds each of the
+  // analytics_thresholds, and the diagonal of the bounding box of the region
+  // where u exceeds front_threshold (empty disables the analytics).
+  std::string         analytics_file_name;
+  std::vector<double> analytics_thresholds = {0.1, 0.5, 0.9};
+  double              front_threshold      = 0.5;
+
+  // Print a line per time step, Newton iteration and linear solve. Setup and
+  // final summaries are always printed; on many processes, the output of the
+  // time loop can hold back the first one.
+  bool print_progress = true;
+
+  // File receiving one record per time step, rejected adaptive steps
+  // included: time, time step, Newton residual norms, CG iterations, and the
+  // wall times of the first process in preconditioner setup, assembly, linear
+  // solves and output. The first process writes it from values it already
+  // has, so no communication is added (empty disables the telemetry).
+  std::string telemetry_file_name;
+
+  // Format of the telemetry file.
+  enum class TelemetryFormat {
+    // One line per time step, the residual norms separated by semicolons.
+    csv,
+    // One JSON object per line.
+    json_lines
+  };
+
+  TelemetryFormat telemetry_format = TelemetryFormat::csv;
+
+  // Print the load balance report at the end of every run (see
+  // HeatNonLinear::report_load_balance()), and write the values of every
+  // process to load_balance_file_name as CSV (if not empty).
+  bool        load_balance_report = false;
+  std::string load_balance_file_name;
+
+  // Read hardware performance counters over every timer section, and print
+  // them with the derived metrics at the end of every run (see
+  // HeatNonLinear::report_hardware_counters()). Only the thread entering a
+  // section is counted, so with n_threads > 1 part of the cell loop is missed.
+  // If the counters cannot be opened, the run goes on without them.
+  bool perf_counters = false;
+
+  // Raw perf event code counting floating point operations, which depends on
+  // the processor (0: FLOPs are not counted).
+  std::uint64_t perf_flops_event = 0;
+
+  // Time steps between two checkpoints (0 disables them). Checkpoints are
+  // written in turn to checkpoint_copies files named
+  // <checkpoint_prefix>-<k>.bin, so that the last complete one survives a
+  // crash while the next one is written.
+  unsigned int checkpoint_interval = 0;
+  unsigned int checkpoint_copies   = 2;
+  std::string  checkpoint_prefix   = "checkpoint";
+
+  // Checkpoint to restart from (empty: start from the initial condition).
+  // Any number of processes can read it. The run that wrote it rebuilds the
+  // Jacobian and the preconditioners after every checkpoint, as a restart
+  // does, so that on the same processes the continuation is bitwise identical
+  // to the original run; on others it differs by the order of the sums.
+  std::string restart_file;
+};
+
+// Physical parameters of a run, which can change between runs on the same mesh
+// (see HeatNonLinear::set_scenario()). The defaults are those of the
+// constructor.
+struct HeatNonLinearScenario {
+  // Prepended to the analytics and checkpoint file names (if not empty).
+  std::string name;
+
+  // Reaction coefficient.
+  double alpha = 2.0;
+
+  // Extracellular and axonal diffusion, and axon direction.
+  double              d_ext          = 10.0;
+  double              d_axn          = 0.0;
+  std::vector<double> axon_direction = {1, 1, 1};
+
+  // Center of the initial seed of misfolded proteins (only the first dim
+  // coordinates are used in lower dimension).
+  Point<3> seed = Point<3>(50, 80, 70);
+
+  // The seed is amplitude exp(-|sharpness (x - seed)|^2), cut off outside the
+  // box of half side seed_radius around its center.
+  double seed_amplitude = 1.0;
+  double seed_radius    = 1.0;
+  double seed_sharpness = 2.0;
+
+  // Final time and time step.
+  double T      = 10.0;
+  double deltat = 0.1;
+};
+
+// Class representing the non-linear diffusion problem, in dimension dim (1D,
+// 2D, 3D) with FE_SimplexP elements of the given degree. Prion.cpp
+// instantiates P1 and P2 in every dimension.
+template <int dim, unsigned int degree>
 class HeatNonLinear {
 public:
-  // Physical dimension (1D, 2D, 3D)
-  static constexpr unsigned int dim = 3;
+  // DoFs per cell, known at compile time so that the batch kernel is
+  // specialized for the element.
+  static constexpr unsigned int n_dofs_per_cell =
+    (degree == 1) ? dim + 1 : (degree == 2) ? (dim + 1) * (dim + 2) / 2 : 0;
 
-  // Function for the mu_0 coefficient.
+  // Upper bound on the quadrature nodes per cell of QGaussSimplex<dim>(degree
+  // + 1), for the batch kernel (0: no batch kernel for this degree).
+  static constexpr unsigned int batch_max_n_q = (degree == 1) ? 4 : (degree == 2) ? 16 : 0;
+
+  // Function for the mu_0 coefficient (evaluated only with
+  // HeatNonLinearSettings::spatial_alpha).
   class FunctionAlpha : public Function<dim> {
   public:
     virtual double
     value(const Point<dim> & /*p*/, const unsigned int /*component*/ = 0) const override {
-      return 2.0;
+      return coefficient;
     }
+
+    double coefficient = 2.0;
   };
 
   void
@@ -69,15 +433,15 @@ public:
   }
 
   Tensor<2, dim>
-  set_up_diffusivity() {
+  set_up_diffusivity(const double &d_ext_, const double &d_axn_) const {
     Tensor<2, dim> result;
 
       for (unsigned int i = 0; i < dim; ++i) {
           for (unsigned int j = 0; j < dim; ++j) {
             if (i != j)
-              result[i][j] = d_axn * axon_direction[i] * axon_direction[j];
+              result[i][j] = d_axn_ * axon_direction[i] * axon_direction[j];
             else
-              result[i][j] = d_ext + d_axn * axon_direction[i] * axon_direction[j];
+              result[i][j] = d_ext_ + d_axn_ * axon_direction[i] * axon_direction[j];
           }
       }
 
@@ -91,35 +455,186 @@ public:
   public:
     virtual double
     value(const Point<dim> &p, const unsigned int /*component*/ = 0) const override {
-      // for the cube mesh
-      // if (p[0] > 0.4 && p[0] < 0.6 && p[1] > 0.4 && p[1] < 0.6 && p[2] > 0.4 &&
-      //     p[2] < 0.6)
-      //   return 0.1 *
-      //          std::exp(-std::pow(30 * (p[0] - 0.5), 2) - std::pow(30 * (p[1] - 0.5), 2) -
-      //                   std::pow(30 * (p[2] - 0.5), 2));
-
-      // for the brain mesh
-      if (p[0] > 49 && p[0] < 51 && p[1] > 79 && p[1] < 81 && p[2] > 69 && p[2] < 71)
-        return 1.0 *
-               std::exp(-std::pow(2 * (p[0] - 50), 2) - std::pow(2 * (p[1] - 80), 2) -
-                        std::pow(2 * (p[2] - 70), 2));
-
-      return 0.0;
+      double exponent = 0.0;
+
+        for (unsigned int d = 0; d < dim; ++d) {
+          if (std::abs(p[d] - center[d]) >= radius)
+            return 0.0;
+
+          exponent += std::pow(sharpness * (p[d] - center[d]), 2);
+        }
+
+      return amplitude * std::exp(-exponent);
     }
+
+    // Center and shape of the seed (see HeatNonLinearScenario).
+    Point<dim> center;
+    double     amplitude = 1.0;
+    double     radius    = 1.0;
+    double     sharpness = 2.0;
+  };
+
+  // Matrix-free action of the Jacobian M / tau + K_D - alpha M (1 - 2u),
+  // linearized around the current Newton iterate, with tau the step of the
+  // current stage. It provides the vmult() interface needed by SolverCG.
+  class JacobianOperator {
+  public:
+    JacobianOperator(const HeatNonLinear &problem_) : problem(problem_) {}
+
+    // dst = J * src.
+    void
+    vmult(TrilinosWrappers::MPI::Vector       &dst,
+          const TrilinosWrappers::MPI::Vector &src) const;
+
+    // Drop the data laid out for the previous DoFs, after the mesh changed.
+    void
+    clear() {
+      src_ghosted.clear();
+      cached_cells.clear();
+    }
+
+  private:
+    // Problem the operator belongs to.
+    const HeatNonLinear &problem;
+
+    // Copy of the input vector including ghost elements.
+    mutable TrilinosWrappers::MPI::Vector src_ghosted;
+
+    // Indices of the cached cells, which the threads share out.
+    mutable std::vector<unsigned int> cached_cells;
+  };
+
+  // Per-thread scratch data of the cell assembly loops (and of the
+  // matrix-free operator). The reaction term alone needs no gradients.
+  struct AssemblyScratchData {
+    AssemblyScratchData(const FiniteElement<dim> &fe,
+                        const Quadrature<dim>    &quadrature,
+                        const UpdateFlags        &alpha_flags,
+                        const bool               &assemble_matrix_,
+                        const bool               &assemble_operator_,
+                        const bool               &gradients = true);
+
+    // FEValues cannot be copied, so it is rebuilt.
+    AssemblyScratchData(const AssemblyScratchData &scratch_data);
+
+    FEValues<dim> fe_values;
+
+    // What to assemble besides the residual.
+    bool assemble_matrix;
+    bool assemble_operator;
+
+    // DoF values of u n+1 and of the stage base w on the current cell.
+    std::vector<double> solution_dofs;
+    std::vector<double> base_dofs;
+
+    // Value and gradient of u n+1, and value of w, at the quadrature nodes.
+    std::vector<double>         solution_loc;
+    std::vector<Tensor<1, dim>> solution_gradient_loc;
+    std::vector<double>         base_loc;
+  };
+
+  // Contribution of one cell, added to the global objects by one thread at a
+  // time.
+  struct AssemblyCopyData {
+    AssemblyCopyData(const unsigned int &dofs_per_cell);
+
+    FullMatrix<double>                   cell_matrix;
+    Vector<double>                       cell_residual;
+    Vector<double>                       cell_diagonal;
+    std::vector<types::global_dof_index> dof_indices;
+  };
+
+  // Contributions of a batch of cells, one per SIMD lane.
+  struct AssemblyBatchCopyData {
+    AssemblyBatchCopyData(const unsigned int &dofs_per_cell);
+
+    // Number of lanes holding a cell (the last batch may be incomplete).
+    unsigned int n_filled = 0;
+
+    std::vector<AssemblyCopyData> cells;
+  };
+
+  // Snapshot of the solution being written. The patches are built without
+  // any MPI communication, so that this can happen in a background thread.
+  struct OutputJob {
+    // Copy of the output vector (including ghost elements).
+    TrilinosWrappers::MPI::Vector solution;
+
+    unsigned int time_step = 0;
+    double       time      = 0.0;
+
+    // Filtered patches, which hold a copy of the data to write.
+    std::unique_ptr<DataOutBase::DataOutFilter> data_filter;
+
+    // Thread building the patches.
+    std::thread thread;
+
+    // Whether the job still has to be written.
+    bool pending = false;
+  };
+
+  // Counters and controller state of the time loop, saved in checkpoints
+  // together with the time and the time step.
+  struct TimeLoopState {
+    unsigned int time_step = 0;
+
+    // Index and time of the next output.
+    unsigned int n_output    = 1;
+    double       next_output = 0.0;
+
+    // Adaptive time stepping only.
+    double deltat_previous = 0.0;
+    double error_norm_old  = 1.0;
+  };
+
+  // Solver statistics of the current time step, for the telemetry file.
+  struct StepTelemetry {
+    // Newton iterations (linear solves), and the residual norm at every one
+    // of them followed by the one that met the tolerance.
+    unsigned int        newton_iterations = 0;
+    std::vector<double> residual_norms;
+
+    unsigned int linear_iterations = 0;
+
+    // Wall times of this process, in seconds. The solve time does not include
+    // the preconditioner setup.
+    double preconditioner_time = 0.0;
+    double assembly_time       = 0.0;
+    double solve_time          = 0.0;
+    double output_time         = 0.0;
+  };
+
+  // Time per cell of the cell assembly kernels, in seconds, as set by the
+  // slowest process (0 for a kernel not available with the current settings).
+  struct AssemblyKernelTimes {
+    // local_assemble_system(), with FEValues::reinit() on every cell.
+    double fe_values = 0.0;
+    // local_assemble_system() with the diffusivity of the regions instead of
+    // the per-cell one (0 without a fiber file).
+    double fe_values_constant_D = 0.0;
+    // local_assemble_system_cached().
+    double cached = 0.0;
+    // local_assemble_batch().
+    double batch = 0.0;
   };
 
   // Constructor. We provide the final time, time step Delta t and theta method
   // parameter as constructor arguments.
-  HeatNonLinear(const unsigned int &N_,
-                const unsigned int &r_,
-                const double       &T_,
-                const double       &deltat_) :
-    mpi_size(Utilities::MPI::n_mpi_processes(MPI_COMM_WORLD)),
-    mpi_rank(Utilities::MPI::this_mpi_process(MPI_COMM_WORLD)),
-    pcout(std::cout, mpi_rank == 0), T(T_), N(N_), r(r_), deltat(deltat_),
-    mesh(MPI_COMM_WORLD),
-    timer_output(MPI_COMM_WORLD, pcout, TimerOutput::summary, TimerOutput::wall_times) {
-    D = set_up_diffusivity();
+  HeatNonLinear(const unsigned int          &N_,
+                const double                &T_,
+                const double                &deltat_,
+                const HeatNonLinearSettings &settings_ = HeatNonLinearSettings(),
+                const MPI_Comm              &mpi_comm_ = MPI_COMM_WORLD) :
+    mpi_comm(mpi_comm_), mpi_size(Utilities::MPI::n_mpi_processes(mpi_comm)),
+    mpi_rank(Utilities::MPI::this_mpi_process(mpi_comm)), pcout(std::cout, mpi_rank == 0),
+    pcout_steps(std::cout, mpi_rank == 0 && settings_.print_progress), settings(settings_),
+    T(T_), N(N_), deltat(deltat_), mesh(mpi_comm), jacobian_operator(*this),
+    timer_output(mpi_comm, pcout, TimerOutput::summary, TimerOutput::wall_times),
+    section_counters(settings.perf_counters, settings.perf_flops_event) {
+    D = set_up_diffusivity(d_ext, d_axn);
+    set_up_regions();
+    set_seed(HeatNonLinearScenario());
+    MultithreadInfo::set_thread_limit(settings.n_threads);
   }
 
   // Initialization.
@@ -130,25 +645,371 @@ public:
   void
   solve();
 
+  // Change the physical parameters for the next call to solve(), keeping the
+  // mesh, the DoFs and the sparsity pattern.
+  void
+  set_scenario(const HeatNonLinearScenario &scenario);
+
+  // Integral of the current solution over the domain.
+  double
+  integral() const;
+
+  // Maximum of the current solution.
+  double
+  max_value() const {
+    return solution_owned.max();
+  }
+
+  // Time steps taken by the last call to solve().
+  unsigned int
+  n_time_steps() const {
+    return n_steps;
+  }
+
+  // Newton iterations and linear solver iterations of the last call to
+  // solve().
+  unsigned int
+  n_newton_iterations() const {
+    return n_newton;
+  }
+
+  unsigned int
+  n_linear_iterations() const {
+    return n_linear;
+  }
+
+  // Number of active cells and of DoFs (after setup()).
+  types::global_cell_index
+  n_cells() const {
+    return mesh.n_global_active_cells();
+  }
+
+  types::global_dof_index
+  n_dofs() const {
+    return dof_handler.n_dofs();
+  }
+
+  // Minimum, maximum and average over the processes of the wall time spent so
+  // far in every timer section. Collective.
+  std::map<std::string, Utilities::MPI::MinMaxAvg>
+  section_times() const;
+
+  // Print the distribution over the processes of the owned cells and DoFs,
+  // the ghost DoFs, the neighbor processes, the bytes and wall time of the
+  // ghost updates, and the wall time of every timer section, with the rank
+  // holding the maximum. The values of every process are also written to the
+  // given CSV file (if not empty). Collective.
+  void
+  report_load_balance(const std::string &file_name = "") const;
+
+  // Print the hardware counters of every timer section summed over the
+  // processes, with the instructions per cycle, the memory traffic per DoF
+  // and call estimated from the cache misses, and the achieved GFLOP/s (if
+  // FLOPs are counted). Collective.
+  void
+  report_hardware_counters() const;
+
+  // Time each available cell assembly kernel over n_sweeps sweeps of the
+  // owned cells, keeping the fastest sweep. Only the copy data of the kernels
+  // is written, so this can be called at any time after setup(). Collective.
+  AssemblyKernelTimes
+  measure_assembly_kernels(const unsigned int &n_sweeps = 1);
+
 protected:
-  // Assemble the tangent problem.
+  // Timer section covering the enclosing scope (see enter_section()).
+  class SectionScope {
+  public:
+    SectionScope(HeatNonLinear &problem_, const std::string &name) : problem(problem_) {
+      problem.enter_section(name);
+    }
+
+    ~SectionScope() {
+      problem.leave_section();
+    }
+
+  private:
+    HeatNonLinear &problem;
+  };
+
+  // Enter a timer section, which also reads the hardware counters if they
+  // are enabled.
   void
-  assemble_system();
+  enter_section(const std::string &name) {
+    timer_output.enter_subsection(name);
+    section_counters.enter(name);
+  }
+
+  // Leave the last timer section entered.
+  void
+  leave_section() {
+    section_counters.leave();
+    timer_output.leave_subsection();
+  }
+
+  // Write the pending outputs and print the enabled reports at the end of
+  // solve().
+  void
+  finish_run(const TimeLoopState &state);
+
+  // Center and shape of the initial seed.
+  void
+  set_seed(const HeatNonLinearScenario &scenario) {
+    for (unsigned int d = 0; d < dim; ++d)
+      u_0.center[d] = scenario.seed[d];
+    u_0.amplitude = scenario.seed_amplitude;
+    u_0.radius    = scenario.seed_radius;
+    u_0.sharpness = scenario.seed_sharpness;
+  }
 
-  // Solve the linear system associated to the tangent problem.
+  // Read, partition and distribute the mesh.
   void
-  solve_linear_system();
+  create_mesh();
 
-  // Solve the problem for one time step using Newton's method.
+  // Set up everything that depends on the mesh: the per-cell data, the DoFs,
+  // the linear system, the geometry cache and the constant matrices.
   void
+  setup_system();
+
+  // Coarse cell of the mesh read by setup() that the given cell is part of.
+  template <typename CellIterator>
+  types::coarse_cell_id
+  original_cell_id(const CellIterator &cell) const {
+    const types::coarse_cell_id id = cell->id().get_coarse_cell_id();
+    return front_mesh.n_cells() > 0 ? front_mesh.root(id) : id;
+  }
+
+  // Read the per-cell diffusivity of the owned cells from the fiber file.
+  void
+  read_fiber_file();
+
+  // Reaction coefficient and diffusivity of a region of the mesh.
+  struct RegionCoefficients {
+    double         alpha;
+    Tensor<2, dim> D;
+  };
+
+  // Build the region table from the settings and the current coefficients.
+  void
+  set_up_regions();
+
+  // Coefficients of the cells with the given material id.
+  const RegionCoefficients &
+  region(const types::material_id &material_id) const {
+    return material_id < region_table.size() ? region_table[material_id] : default_region;
+  }
+
+  // Diffusivity of the given owned cell.
+  Tensor<2, dim>
+  diffusivity(const unsigned int &cell_index, const types::material_id &material_id) const {
+    return cell_diffusivity.empty() ?
+             region(material_id).D :
+             static_cast<Tensor<2, dim>>(cell_diffusivity[cell_index]);
+  }
+
+  // Update flags needed by alpha_value().
+  UpdateFlags
+  alpha_flags() const {
+    return settings.spatial_alpha ? update_quadrature_points : update_default;
+  }
+
+  // Reaction coefficient at the q-th quadrature node of the cell fe_values is
+  // initialized on, given the coefficient of the region of the cell.
+  double
+  alpha_value(const FEValues<dim> &fe_values,
+              const unsigned int  &q,
+              const double        &region_alpha) const {
+    return settings.spatial_alpha ? alpha.value(fe_values.quadrature_point(q)) : region_alpha;
+  }
+
+  // Copy an owned vector into a ghosted one, which imports the ghost values
+  // from the neighbor processes, and account for it in the load balance
+  // report.
+  void
+  update_ghost_values(TrilinosWrappers::MPI::Vector       &ghosted,
+                      const TrilinosWrappers::MPI::Vector &owned) const {
+    Timer timer;
+    ghosted = owned;
+    ghost_update_time += timer.wall_time();
+    ++n_ghost_updates;
+  }
+
+  // Fill the geometry cache with the current coefficients.
+  void
+  reinit_geometry_cache();
+
+  // Whether the mass and stiffness matrices are assembled once in setup().
+  bool
+  use_constant_matrices() const {
+    return settings.jacobian_mode == HeatNonLinearSettings::JacobianMode::assembled &&
+           (settings.assembly != HeatNonLinearSettings::Assembly::full ||
+            settings.splitting == HeatNonLinearSettings::Splitting::strang);
+  }
+
+  // Assemble the solution-independent mass and stiffness matrices.
+  void
+  assemble_constant_matrices();
+
+  // Assemble the tangent problem from the precomputed matrices.
+  void
+  assemble_reaction_system(const bool &assemble_jacobian);
+
+  // Assemble the contribution of one cell to the tangent problem.
+  void
+  local_assemble_system(const typename DoFHandler<dim>::active_cell_iterator &cell,
+                        AssemblyScratchData                                  &scratch_data,
+                        AssemblyCopyData                                     &copy_data);
+
+  // Same as local_assemble_system(), reading the geometry cache.
+  void
+  local_assemble_system_cached(const typename DoFHandler<dim>::active_cell_iterator &cell,
+                               AssemblyScratchData                                  &scratch_data,
+                               AssemblyCopyData                                     &copy_data);
+
+  // Whether the cells are assembled in batches by local_assemble_batch().
+  bool
+  use_batch_kernel() const;
+
+  // Assemble the batch of cached cells starting at the given owned cell,
+  // dispatching to the kernel of the current element.
+  void
+  local_assemble_batch(const unsigned int    &first_cell,
+                       AssemblyScratchData   &scratch_data,
+                       AssemblyBatchCopyData &copy_data);
+
+  // Batch kernel for n_dofs DoFs and at most max_n_q quadrature nodes per
+  // cell: local matrices live on the stack and each lane holds one cell of a
+  // batch of batch_cache.
+  template <unsigned int n_dofs, unsigned int max_n_q>
+  void
+  local_assemble_batch_kernel(const unsigned int    &first_cell,
+                              AssemblyScratchData   &scratch_data,
+                              AssemblyBatchCopyData &copy_data);
+
+  // Print the time per cell of the assembly kernels, measured by one sweep
+  // over the owned cells.
+  void
+  report_assembly_kernels();
+
+  // Assemble the tangent problem. If assemble_jacobian is false, only the
+  // residual is updated and the previous Jacobian is kept.
+  void
+  assemble_system(const bool &assemble_jacobian = true);
+
+  // (Re)build the AMG preconditioner from the current Jacobian.
+  void
+  setup_amg_preconditioner();
+
+  // Solve the linear system associated to the tangent problem, up to the
+  // given absolute tolerance.
+  void
+  solve_linear_system(const double &tolerance);
+
+  // Solve the current stage using Newton's method. Returns false if the
+  // residual is still above the tolerance after the maximum number of
+  // iterations.
+  bool
   solve_newton();
 
-  // Output.
+  // Solve the stage M (u - w) / tau = F(u), with w in stage_base_owned,
+  // starting from the current solution. Returns whether Newton's method
+  // converged.
+  bool
+  solve_stage(const double &tau);
+
+  // Advance the solution from u n in solution_old_owned over deltat with the
+  // selected time scheme (monolithic problem only). The time step counts from
+  // 1 since the initial condition. Returns false, leaving the solution of the
+  // failed stage, if Newton's method did not converge on one of the stages.
+  bool
+  solve_time_step(const unsigned int &time_step);
+
+  // Exact logistic reaction over a time tau at every owned node.
   void
-  output(const unsigned int &time_step, const double &time) const;
+  solve_reaction(const double &tau);
+
+  // Advance one time step with Strang splitting.
+  void
+  solve_splitting_step();
+
+  // Time loop with adaptive time step, called by solve().
+  void
+  solve_adaptive(TimeLoopState &state);
+
+  // Write a checkpoint of the current solution, the one at the previous
+  // step, the time derivative of the theta method, the time and the time loop
+  // state, with MPI-IO, and reset the solver state a restart cannot restore.
+  // Cell values are stored by coarse cell id, which does not depend on the
+  // partition.
+  void
+  write_checkpoint(const TimeLoopState                 &state,
+                   const TrilinosWrappers::MPI::Vector &previous_solution_owned);
+
+  // Restore what write_checkpoint() saved, the previous solution going to
+  // solution_old_owned.
+  void
+  read_checkpoint(TimeLoopState &state);
+
+  // Rebuild the mesh around the front, following the gradient indicator h_K
+  // ||grad u||_K, and interpolate the solution and the previous ones on it
+  // (see HeatNonLinearSettings::front_interval). Collective.
+  void
+  adapt_mesh_to_front();
+
+  // Reduce the analytics of the current solution and append them to the
+  // analytics file.
+  void
+  write_analytics(const unsigned int &time_step);
+
+  // Output of the given (ghosted) vector. The vector is copied, so that it
+  // can be changed as soon as this returns.
+  void
+  output(const unsigned int                  &time_step,
+         const double                        &time,
+         const TrilinosWrappers::MPI::Vector &u);
+
+  // Output of the current solution.
+  void
+  output(const unsigned int &time_step, const double &time) {
+    output(time_step, time, solution);
+  }
+
+  // Build the patches of an output job (no MPI communication).
+  void
+  build_output_patches(OutputJob &job) const;
+
+  // Wait for the patches of an output job and write them to file.
+  void
+  write_output_job(OutputJob &job);
+
+  // Write the output jobs still pending, in order.
+  void
+  finish_output();
+
+  // Open the telemetry file, appending to it when restarting (first process
+  // only).
+  void
+  open_telemetry(const bool &restart);
+
+  // Write the record of a time step ending at the given time, and start the
+  // next one (first process only).
+  void
+  write_telemetry(const unsigned int &time_step,
+                  const double       &step_time,
+                  const double       &step_deltat,
+                  const bool         &accepted);
+
+  // Name of an output file of the run, prefixed with the scenario name (empty
+  // if file_name is).
+  std::string
+  run_file_name(const std::string &file_name) const {
+    return (run_name.empty() || file_name.empty()) ? file_name : run_name + "-" + file_name;
+  }
 
   // MPI parallel. /////////////////////////////////////////////////////////////
 
+  // Communicator of the processes solving this problem.
+  const MPI_Comm mpi_comm;
+
   // Number of MPI processes.
   const unsigned int mpi_size;
 
@@ -158,6 +1019,13 @@ protected:
   // Parallel output stream.
   ConditionalOStream pcout;
 
+  // Parallel output stream of the progress of the time loop (silent unless
+  // settings.print_progress).
+  ConditionalOStream pcout_steps;
+
+  // Run-time options.
+  const HeatNonLinearSettings settings;
+
   // Problem definition. ///////////////////////////////////////////////////////
 
   // mu_0 coefficient.
@@ -170,30 +1038,56 @@ protected:
   double time;
 
   // Final time.
-  const double T;
+  double T;
+
+  std::vector<double> axon_direction = {1, 1, 1};
 
-  const std::vector<double> axon_direction = {1, 1, 1};
+  double d_ext = 10.0;
+  double d_axn = 0.0;
 
-  const double d_ext = 10.0;
-  const double d_axn = 0.0;
+  // Name of the current scenario (empty by default).
+  std::string run_name;
+
+  // Time steps taken by the last call to solve().
+  unsigned int n_steps = 0;
+
+  // Newton and linear solver iterations of the last call to solve().
+  unsigned int n_newton = 0;
+  unsigned int n_linear = 0;
 
   // Diffusivity tensor
   Tensor<2, dim> D;
 
+  // Coefficients of the regions, indexed by material id up to the largest one
+  // in the settings, and of the cells of any other material.
+  std::vector<RegionCoefficients> region_table;
+  RegionCoefficients              default_region;
+
+  // Diffusivity of every owned cell, in owned cell order (empty if it only
+  // depends on the region).
+  std::vector<SymmetricTensor<2, dim>> cell_diffusivity;
+
   // Discretization. ///////////////////////////////////////////////////////////
 
   // Mesh refinement.
   const unsigned int N;
 
   // Polynomial degree.
-  const unsigned int r;
+  static constexpr unsigned int r = degree;
 
-  // Time step.
-  const double deltat;
+  // Time step (changed along the run with adaptive time stepping).
+  double deltat;
 
   // Mesh.
   parallel::fullydistributed::Triangulation<dim> mesh;
 
+  // Mesh read by setup() and the one the current mesh was refined to from it,
+  // on every process, and the cells of the former refined in the latter
+  // (adaptation to the front only).
+  SimplexMesh<dim>  original_mesh;
+  SimplexMesh<dim>  front_mesh;
+  std::vector<bool> refined_cells;
+
   // Finite element space.
   std::unique_ptr<FiniteElement<dim>> fe;
 
@@ -203,15 +1097,71 @@ protected:
   // DoF handler.
   DoFHandler<dim> dof_handler;
 
+  // Position of every locally owned cell among the owned ones, indexed by
+  // active_cell_index(). Per-cell data (geometry cache, matrix-free
+  // coefficients) is stored in this order.
+  std::vector<unsigned int> owned_cell_index;
+
+  // Geometry and shape function data of the owned cells.
+  CellGeometryCache<dim> geometry_cache;
+
+  // The same data in SIMD batches, for the batch kernel only.
+  CellBatchCache<dim> batch_cache;
+
   // DoFs owned by current process.
   IndexSet locally_owned_dofs;
 
   // DoFs relevant to the current process (including ghost DoFs).
   IndexSet locally_relevant_dofs;
 
-  // Jacobian matrix.
+  // Jacobian matrix (only allocated when the Jacobian is assembled).
   TrilinosWrappers::SparseMatrix jacobian_matrix;
 
+  // Mass matrix (only allocated when the constant matrices are precomputed).
+  TrilinosWrappers::SparseMatrix mass_matrix;
+
+  // Anisotropic stiffness matrix, int grad(phi_i) . D grad(phi_j) (only
+  // allocated when the constant matrices are precomputed).
+  TrilinosWrappers::SparseMatrix stiffness_matrix;
+
+  // Row sums of the mass matrix (lumped group formulation only).
+  TrilinosWrappers::MPI::Vector lumped_mass;
+
+  // Nodal interpolant of alpha (lumped group formulation and splitting only).
+  TrilinosWrappers::MPI::Vector alpha_nodal;
+
+  // Whether the Jacobian must be reassembled at the next Newton iteration
+  // (only relevant when the Jacobian is lagged).
+  bool jacobian_outdated = true;
+
+  // SSOR preconditioner of jacobian_matrix, rebuilt whenever the Jacobian is.
+  TrilinosWrappers::PreconditionSSOR ssor_preconditioner;
+
+  // Whether ssor_preconditioner has to be rebuilt before the next solve.
+  bool ssor_outdated = true;
+
+  // AMG preconditioner of jacobian_matrix, reused across Newton iterations and
+  // time steps.
+  TrilinosWrappers::PreconditionAMG amg_preconditioner;
+
+  // Whether amg_preconditioner has to be rebuilt before the next solve.
+  bool amg_outdated = true;
+
+  // CG iterations of the first solve after the last AMG setup (0 if no solve
+  // happened since then).
+  unsigned int amg_reference_iterations = 0;
+
+  // Jacobian operator, used instead of jacobian_matrix in matrix-free mode.
+  JacobianOperator jacobian_operator;
+
+  // Linearized reaction coefficient alpha (1 - 2u) at every quadrature node of
+  // the locally owned cells, stored when the residual is assembled and read
+  // back by jacobian_operator.
+  std::vector<double> reaction_coefficient;
+
+  // Jacobi preconditioner of the matrix-free Jacobian (inverse diagonal).
+  DiagonalMatrix<TrilinosWrappers::MPI::Vector> jacobi_preconditioner;
+
   // Residual vector.
   TrilinosWrappers::MPI::Vector residual_vector;
 
@@ -224,10 +1174,54 @@ protected:
   // System solution (including ghost elements).
   TrilinosWrappers::MPI::Vector solution;
 
-  // System solution at previous time step.
-  TrilinosWrappers::MPI::Vector solution_old;
+  // System solution at previous time step (without ghost elements).
+  TrilinosWrappers::MPI::Vector solution_old_owned;
+
+  // System solution two time steps before (BDF2 and adaptive time stepping).
+  TrilinosWrappers::MPI::Vector solution_older_owned;
+
+  // Base w of the stage being solved (including ghost elements, and without
+  // them), and its step tau (see solve_stage()).
+  TrilinosWrappers::MPI::Vector stage_base;
+  TrilinosWrappers::MPI::Vector stage_base_owned;
+  double                        stage_deltat = 0.0;
+
+  // Derivatives M^-1 F(U_i) of the SDIRK stages, which follow from the stage
+  // equation as (U_i - w_i) / tau without solving with M.
+  std::vector<TrilinosWrappers::MPI::Vector> stage_derivatives;
+
+  // Derivative M^-1 F(u n) of the theta method, and whether it is known
+  // (only after a step of this run).
+  TrilinosWrappers::MPI::Vector time_derivative_owned;
+  bool                          time_derivative_available = false;
+
+  // Double buffer of output jobs: one can be written while the patches of
+  // the other are built.
+  std::array<OutputJob, 2> output_jobs;
+
+  // Number of output jobs started so far.
+  unsigned int n_output_jobs = 0;
+
+  // Writer of the output time series, created by solve() for every run so
+  // that each scenario gets its own files.
+  std::unique_ptr<TimeSeriesWriter<dim>> output_writer;
+
+  // Number of checkpoints written so far.
+  unsigned int n_checkpoints = 0;
+
+  // Ghost updates done so far by update_ghost_values(), and the wall time
+  // spent in them, waiting for the neighbors included.
+  mutable unsigned long long n_ghost_updates   = 0;
+  mutable double             ghost_update_time = 0.0;
+
+  // Statistics of the current time step, and the file they go to.
+  StepTelemetry step_telemetry;
+  std::ofstream telemetry_file;
 
   TimerOutput timer_output;
+
+  // Hardware counters of the timer sections.
+  PerfCounters section_counters;
 };
 
 #endif
\ No newline at end of file
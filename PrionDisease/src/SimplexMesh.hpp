@@ -0,0 +1,587 @@
+#ifndef SIMPLEX_MESH_HPP
+#define SIMPLEX_MESH_HPP
+
+#include <deal.II/base/exceptions.h>
+#include <deal.II/base/mpi.h>
+#include <deal.II/base/point.h>
+
+#include <deal.II/grid/cell_id.h>
+#include <deal.II/grid/reference_cell.h>
+#include <deal.II/grid/tria.h>
+#include <deal.II/grid/tria_description.h>
+
+#include <deal.II/lac/dynamic_sparsity_pattern.h>
+#include <deal.II/lac/sparsity_pattern.h>
+#include <deal.II/lac/sparsity_tools.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <map>
+#include <numeric>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+using namespace dealii;
+
+// Conforming simplex mesh stored as plain arrays, which is refined locally by
+// bisection and distributed without building a serial Triangulation.
+//
+// A cell is always bisected at its longest edge, ties being broken by the
+// coordinates of the vertices and not by their indices, so that how a cell is
+// split only depends on its geometry. All the meshes refined from the same
+// coarse mesh are then leaves of one bisection forest, and a piecewise linear
+// function moves exactly from one to the other (see interpolate()).
+template <int dim>
+class SimplexMesh {
+public:
+  static constexpr unsigned int n_cell_vertices = dim + 1;
+  static constexpr unsigned int n_face_vertices = dim;
+
+  using Cell = std::array<unsigned int, n_cell_vertices>;
+  using Face = std::array<unsigned int, n_face_vertices>;
+
+  // Copy the cells of a coarse serial mesh, with the non-zero boundary ids of
+  // their faces.
+  void
+  reinit(const Triangulation<dim> &mesh);
+
+  // Take the given coarse cells, with the non-zero boundary ids of their faces
+  // keyed by the sorted face vertices.
+  void
+  reinit(std::vector<Point<dim>>            &&vertices,
+         std::vector<Cell>                  &&cells,
+         std::vector<types::material_id>    &&material_ids,
+         std::map<Face, types::boundary_id> &&boundary_ids);
+
+  // Send the coarse mesh of the root process to the other ones. Collective.
+  void
+  broadcast(const MPI_Comm &comm, const unsigned int &root = 0);
+
+  // Mesh obtained from this one, taken as the coarse mesh, by bisecting
+  // n_bisections times all the cells of the marked coarse cells, and the
+  // other cells as needed to keep the mesh conforming.
+  SimplexMesh
+  refine(const std::vector<bool> &marked, const unsigned int &n_bisections) const;
+
+  // Cells sharing a vertex with one of the selected cells, these included.
+  std::vector<bool>
+  vertex_neighbors(const std::vector<bool> &selected) const;
+
+  // Part of every cell in a partition into n_parts parts by METIS, computed
+  // by the root process. Collective.
+  std::vector<unsigned int>
+  partition(const unsigned int &n_parts, const MPI_Comm &comm, const unsigned int &root = 0) const;
+
+  // Description of the part of this process for a
+  // parallel::fullydistributed::Triangulation: its cells and those sharing a
+  // vertex with them, the cell index being the coarse cell id.
+  TriangulationDescription::Description<dim>
+  create_description(const std::vector<unsigned int> &partition, const MPI_Comm &comm) const;
+
+  // Vertex values of the continuous piecewise linear function with the given
+  // vertex values on another mesh refined from the same coarse mesh. A vertex
+  // of this mesh is either one of the other mesh, or lies on a segment
+  // within one of its cells, so the result is exact.
+  std::vector<double>
+  interpolate(const SimplexMesh &other, const std::vector<double> &other_values) const;
+
+  unsigned int
+  n_vertices() const {
+    return vertices.size();
+  }
+
+  unsigned int
+  n_cells() const {
+    return cells.size();
+  }
+
+  // Vertices of a cell, in the order of the cells of the Triangulation.
+  const Cell &
+  cell(const unsigned int &c) const {
+    return cells[c];
+  }
+
+  // Coarse cell a cell was refined from.
+  unsigned int
+  root(const unsigned int &c) const {
+    return roots[c];
+  }
+
+private:
+  // Edges are keyed by their vertices, the smaller one first.
+  static std::uint64_t
+  edge_key(const unsigned int &a, const unsigned int &b) {
+    return (static_cast<std::uint64_t>(std::min(a, b)) << 32) | std::max(a, b);
+  }
+
+  // Vertices of a cell but the k-th one, sorted.
+  static Face
+  face(const Cell &cell, const unsigned int &k) {
+    Face result;
+    for (unsigned int v = 0, i = 0; v < n_cell_vertices; ++v)
+      if (v != k)
+        result[i++] = cell[v];
+    std::sort(result.begin(), result.end());
+    return result;
+  }
+
+  // Take the cells there are as the coarse ones.
+  void
+  clear_refinement();
+
+  // Vertices of the longest edge of a cell.
+  std::pair<unsigned int, unsigned int>
+  refinement_edge(const Cell &cell) const;
+
+  // Whether a cell has a vertex in the middle of one of its edges.
+  bool
+  has_hanging_vertex(const Cell &cell) const;
+
+  // Split the c-th cell in two at its refinement edge: the first half
+  // replaces it, the second one is appended.
+  void
+  bisect(const unsigned int &c);
+
+  std::vector<Point<dim>>         vertices;
+  std::vector<Cell>               cells;
+  std::vector<types::material_id> material_ids;
+  std::vector<unsigned int>       roots;
+
+  // Non-zero boundary ids, by the sorted vertices of the face.
+  std::map<Face, types::boundary_id> boundary_ids;
+
+  // Vertex in the middle of every bisected edge, and the edge every vertex
+  // is the middle of (numbers::invalid_unsigned_int for the coarse ones).
+  std::unordered_map<std::uint64_t, unsigned int>    midpoints;
+  std::vector<std::pair<unsigned int, unsigned int>> parents;
+};
+
+template <int dim>
+void
+SimplexMesh<dim>::reinit(const Triangulation<dim> &mesh) {
+  AssertThrow(mesh.n_levels() == 1, ExcMessage("Only coarse meshes can be copied."));
+
+  vertices = mesh.get_vertices();
+  cells.resize(mesh.n_active_cells());
+  material_ids.resize(mesh.n_active_cells());
+  boundary_ids.clear();
+
+    for (const auto &cell : mesh.active_cell_iterators()) {
+      AssertThrow(cell->n_vertices() == n_cell_vertices,
+                  ExcMessage("Only simplex meshes can be refined by bisection."));
+
+      const unsigned int c = cell->active_cell_index();
+      for (unsigned int v = 0; v < n_cell_vertices; ++v)
+        cells[c][v] = cell->vertex_index(v);
+      material_ids[c] = cell->material_id();
+
+        for (const auto f : cell->face_indices()) {
+          const auto face = cell->face(f);
+          if (!face->at_boundary() || face->boundary_id() == 0)
+            continue;
+
+          Face vertices_of_face;
+          for (unsigned int v = 0; v < n_face_vertices; ++v)
+            vertices_of_face[v] = face->vertex_index(v);
+          std::sort(vertices_of_face.begin(), vertices_of_face.end());
+          boundary_ids[vertices_of_face] = face->boundary_id();
+        }
+    }
+
+  clear_refinement();
+}
+
+template <int dim>
+void
+SimplexMesh<dim>::reinit(std::vector<Point<dim>>            &&vertices,
+                         std::vector<Cell>                  &&cells,
+                         std::vector<types::material_id>    &&material_ids,
+                         std::map<Face, types::boundary_id> &&boundary_ids) {
+  AssertThrow(material_ids.size() == cells.size(),
+              ExcMessage("One material id per cell is needed."));
+
+  this->vertices     = std::move(vertices);
+  this->cells        = std::move(cells);
+  this->material_ids = std::move(material_ids);
+  this->boundary_ids = std::move(boundary_ids);
+
+  clear_refinement();
+}
+
+template <int dim>
+void
+SimplexMesh<dim>::broadcast(const MPI_Comm &comm, const unsigned int &root) {
+  const bool is_root = Utilities::MPI::this_mpi_process(comm) == root;
+
+  unsigned long long sizes[3] = {vertices.size(), cells.size(), boundary_ids.size()};
+  MPI_Bcast(sizes, 3, MPI_UNSIGNED_LONG_LONG, root, comm);
+
+  // Coordinates, then the cells followed by their material id, then the
+  // boundary faces followed by their id.
+  std::vector<double>       coordinates(sizes[0] * dim);
+  std::vector<unsigned int> cell_data(sizes[1] * (n_cell_vertices + 1));
+  std::vector<unsigned int> face_data(sizes[2] * (n_face_vertices + 1));
+
+    if (is_root) {
+      for (unsigned int i = 0; i < vertices.size(); ++i)
+        for (unsigned int d = 0; d < dim; ++d)
+          coordinates[i * dim + d] = vertices[i][d];
+
+        for (unsigned int c = 0; c < cells.size(); ++c) {
+          std::copy(cells[c].begin(), cells[c].end(), &cell_data[c * (n_cell_vertices + 1)]);
+          cell_data[c * (n_cell_vertices + 1) + n_cell_vertices] = material_ids[c];
+        }
+
+      unsigned int f = 0;
+        for (const auto &[vertices_of_face, id] : boundary_ids) {
+          std::copy(vertices_of_face.begin(),
+                    vertices_of_face.end(),
+                    &face_data[f * (n_face_vertices + 1)]);
+          face_data[f * (n_face_vertices + 1) + n_face_vertices] = id;
+          ++f;
+        }
+    }
+
+  MPI_Bcast(coordinates.data(), coordinates.size(), MPI_DOUBLE, root, comm);
+  MPI_Bcast(cell_data.data(), cell_data.size(), MPI_UNSIGNED, root, comm);
+  MPI_Bcast(face_data.data(), face_data.size(), MPI_UNSIGNED, root, comm);
+
+    if (!is_root) {
+      vertices.resize(sizes[0]);
+      for (unsigned int i = 0; i < vertices.size(); ++i)
+        for (unsigned int d = 0; d < dim; ++d)
+          vertices[i][d] = coordinates[i * dim + d];
+
+      cells.resize(sizes[1]);
+      material_ids.resize(sizes[1]);
+        for (unsigned int c = 0; c < cells.size(); ++c) {
+          std::copy(&cell_data[c * (n_cell_vertices + 1)],
+                    &cell_data[c * (n_cell_vertices + 1) + n_cell_vertices],
+                    cells[c].begin());
+          material_ids[c] = cell_data[c * (n_cell_vertices + 1) + n_cell_vertices];
+        }
+
+      boundary_ids.clear();
+        for (unsigned int f = 0; f < sizes[2]; ++f) {
+          Face vertices_of_face;
+          std::copy(&face_data[f * (n_face_vertices + 1)],
+                    &face_data[f * (n_face_vertices + 1) + n_face_vertices],
+                    vertices_of_face.begin());
+          boundary_ids[vertices_of_face] = face_data[f * (n_face_vertices + 1) + n_face_vertices];
+        }
+    }
+
+  clear_refinement();
+}
+
+template <int dim>
+SimplexMesh<dim>
+SimplexMesh<dim>::refine(const std::vector<bool> &marked,
+                         const unsigned int      &n_bisections) const {
+  AssertThrow(marked.size() == cells.size(), ExcMessage("One flag per coarse cell is needed."));
+
+  SimplexMesh result = *this;
+  result.clear_refinement();
+
+    for (unsigned int k = 0; k < n_bisections; ++k) {
+      // Only the cells there are now, not their halves.
+      const unsigned int n_cells = result.cells.size();
+      for (unsigned int c = 0; c < n_cells; ++c)
+        if (marked[result.roots[c]])
+          result.bisect(c);
+
+      // Closure: cells with a hanging vertex are bisected until there is
+      // none left. Bisecting at the longest edge guarantees that this ends.
+      bool changed = true;
+        while (changed) {
+          changed = false;
+            for (unsigned int c = 0; c < result.cells.size(); ++c) {
+                if (result.has_hanging_vertex(result.cells[c])) {
+                  result.bisect(c);
+                  changed = true;
+                }
+            }
+        }
+    }
+
+  return result;
+}
+
+template <int dim>
+std::vector<bool>
+SimplexMesh<dim>::vertex_neighbors(const std::vector<bool> &selected) const {
+  std::vector<bool> selected_vertices(vertices.size(), false);
+  for (unsigned int c = 0; c < cells.size(); ++c)
+    if (selected[c])
+      for (const unsigned int v : cells[c])
+        selected_vertices[v] = true;
+
+  std::vector<bool> result(cells.size(), false);
+  for (unsigned int c = 0; c < cells.size(); ++c)
+    for (const unsigned int v : cells[c])
+      if (selected_vertices[v])
+        result[c] = true;
+
+  return result;
+}
+
+template <int dim>
+std::vector<unsigned int>
+SimplexMesh<dim>::partition(const unsigned int &n_parts,
+                            const MPI_Comm     &comm,
+                            const unsigned int &root) const {
+  std::vector<unsigned int> result(cells.size(), 0);
+  if (n_parts == 1)
+    return result;
+
+    if (Utilities::MPI::this_mpi_process(comm) == root) {
+      // Cells sharing a face are neighbors in the graph, which is the one
+      // GridTools::partition_triangulation() builds.
+      std::vector<std::pair<Face, unsigned int>> faces;
+      faces.reserve(cells.size() * n_cell_vertices);
+      for (unsigned int c = 0; c < cells.size(); ++c)
+        for (unsigned int k = 0; k < n_cell_vertices; ++k)
+          faces.emplace_back(face(cells[c], k), c);
+      std::sort(faces.begin(), faces.end());
+
+      DynamicSparsityPattern graph(cells.size());
+      for (unsigned int c = 0; c < cells.size(); ++c)
+        graph.add(c, c);
+        for (unsigned int i = 0; i + 1 < faces.size(); ++i) {
+            if (faces[i].first == faces[i + 1].first) {
+              graph.add(faces[i].second, faces[i + 1].second);
+              graph.add(faces[i + 1].second, faces[i].second);
+            }
+        }
+
+      SparsityPattern sparsity;
+      sparsity.copy_from(graph);
+      SparsityTools::partition(sparsity, n_parts, result);
+    }
+
+  MPI_Bcast(result.data(), result.size(), MPI_UNSIGNED, root, comm);
+
+  return result;
+}
+
+template <int dim>
+TriangulationDescription::Description<dim>
+SimplexMesh<dim>::create_description(const std::vector<unsigned int> &partition,
+                                     const MPI_Comm                  &comm) const {
+  const unsigned int this_part = Utilities::MPI::this_mpi_process(comm);
+
+  std::vector<bool> owned(cells.size());
+  for (unsigned int c = 0; c < cells.size(); ++c)
+    owned[c] = partition[c] == this_part;
+
+  const std::vector<bool> relevant = vertex_neighbors(owned);
+
+  const ReferenceCell reference_cell = ReferenceCells::get_simplex<dim>();
+
+  TriangulationDescription::Description<dim> description;
+  description.comm = comm;
+  description.cell_infos.resize(1);
+
+  // Vertices of the relevant cells, numbered in order of appearance.
+  std::vector<unsigned int> local_vertex(vertices.size(), numbers::invalid_unsigned_int);
+
+    for (unsigned int c = 0; c < cells.size(); ++c) {
+      if (!relevant[c])
+        continue;
+
+      CellData<dim> coarse_cell;
+      coarse_cell.vertices.resize(n_cell_vertices);
+        for (unsigned int v = 0; v < n_cell_vertices; ++v) {
+            if (local_vertex[cells[c][v]] == numbers::invalid_unsigned_int) {
+              local_vertex[cells[c][v]] = description.coarse_cell_vertices.size();
+              description.coarse_cell_vertices.push_back(vertices[cells[c][v]]);
+            }
+          coarse_cell.vertices[v] = local_vertex[cells[c][v]];
+        }
+      coarse_cell.material_id = material_ids[c];
+
+      description.coarse_cells.push_back(coarse_cell);
+      description.coarse_cell_index_to_coarse_cell_id.push_back(c);
+
+      TriangulationDescription::CellData<dim> cell_info;
+      cell_info.id                 = CellId(c, std::vector<std::uint8_t>()).to_binary<dim>();
+      cell_info.subdomain_id       = partition[c];
+      cell_info.level_subdomain_id = numbers::artificial_subdomain_id;
+      cell_info.manifold_id        = numbers::flat_manifold_id;
+      std::fill(cell_info.manifold_line_ids.begin(),
+                cell_info.manifold_line_ids.end(),
+                numbers::flat_manifold_id);
+      std::fill(cell_info.manifold_quad_ids.begin(),
+                cell_info.manifold_quad_ids.end(),
+                numbers::flat_manifold_id);
+
+        if (!boundary_ids.empty()) {
+            for (unsigned int f = 0; f < reference_cell.n_faces(); ++f) {
+              Face vertices_of_face;
+              for (unsigned int v = 0; v < n_face_vertices; ++v)
+                vertices_of_face[v] = cells[c][reference_cell.face_to_cell_vertices(f, v, 1)];
+              std::sort(vertices_of_face.begin(), vertices_of_face.end());
+
+              const auto boundary = boundary_ids.find(vertices_of_face);
+              if (boundary != boundary_ids.end())
+                cell_info.boundary_ids.emplace_back(f, boundary->second);
+            }
+        }
+
+      description.cell_infos[0].push_back(cell_info);
+    }
+
+  return description;
+}
+
+template <int dim>
+std::vector<double>
+SimplexMesh<dim>::interpolate(const SimplexMesh         &other,
+                              const std::vector<double> &other_values) const {
+  std::vector<double> values(vertices.size());
+
+  // Index of every vertex in the other mesh, if it is one of its vertices.
+  // Parents come before their midpoints, and coarse vertices first of all.
+  std::vector<unsigned int> other_vertex(vertices.size(), numbers::invalid_unsigned_int);
+
+    for (unsigned int v = 0; v < vertices.size(); ++v) {
+      const auto [a, b] = parents[v];
+
+        if (a == numbers::invalid_unsigned_int) {
+          other_vertex[v] = v;
+          values[v]       = other_values[v];
+          continue;
+        }
+
+        // The other mesh has this vertex if it bisected the same edge.
+        if (other_vertex[a] != numbers::invalid_unsigned_int &&
+            other_vertex[b] != numbers::invalid_unsigned_int) {
+          const auto midpoint = other.midpoints.find(edge_key(other_vertex[a], other_vertex[b]));
+            if (midpoint != other.midpoints.end()) {
+              other_vertex[v] = midpoint->second;
+              values[v]       = other_values[midpoint->second];
+              continue;
+            }
+        }
+
+      // Otherwise the edge lies in a cell of the other mesh, where the
+      // function is linear.
+      values[v] = 0.5 * (values[a] + values[b]);
+    }
+
+  return values;
+}
+
+template <int dim>
+void
+SimplexMesh<dim>::clear_refinement() {
+  roots.resize(cells.size());
+  std::iota(roots.begin(), roots.end(), 0u);
+
+  midpoints.clear();
+  parents.assign(vertices.size(),
+                 {numbers::invalid_unsigned_int, numbers::invalid_unsigned_int});
+}
+
+template <int dim>
+std::pair<unsigned int, unsigned int>
+SimplexMesh<dim>::refinement_edge(const Cell &cell) const {
+  // Lexicographic order of the points.
+  const auto less = [](const Point<dim> &p, const Point<dim> &q) {
+    for (unsigned int d = 0; d < dim; ++d)
+      if (p[d] != q[d])
+        return p[d] < q[d];
+    return false;
+  };
+
+  // The longest edge, and the first in lexicographic order among equally
+  // long ones.
+  std::pair<unsigned int, unsigned int> result;
+  double                                result_length = -1.0;
+
+    for (unsigned int i = 0; i < n_cell_vertices; ++i) {
+        for (unsigned int j = i + 1; j < n_cell_vertices; ++j) {
+          // Endpoints in lexicographic order.
+          unsigned int a = cell[i];
+          unsigned int b = cell[j];
+          if (less(vertices[b], vertices[a]))
+            std::swap(a, b);
+
+          const double length = (vertices[a] - vertices[b]).norm_square();
+
+            if (length > result_length ||
+                (length == result_length &&
+                 (less(vertices[a], vertices[result.first]) ||
+                  (!less(vertices[result.first], vertices[a]) &&
+                   less(vertices[b], vertices[result.second]))))) {
+              result        = {a, b};
+              result_length = length;
+            }
+        }
+    }
+
+  return result;
+}
+
+template <int dim>
+bool
+SimplexMesh<dim>::has_hanging_vertex(const Cell &cell) const {
+  for (unsigned int i = 0; i < n_cell_vertices; ++i)
+    for (unsigned int j = i + 1; j < n_cell_vertices; ++j)
+      if (midpoints.count(edge_key(cell[i], cell[j])) > 0)
+        return true;
+  return false;
+}
+
+template <int dim>
+void
+SimplexMesh<dim>::bisect(const unsigned int &c) {
+  const auto [a, b] = refinement_edge(cells[c]);
+
+  // The midpoint may exist already, as a hanging vertex.
+  const auto [midpoint, inserted] = midpoints.emplace(edge_key(a, b), vertices.size());
+    if (inserted) {
+      vertices.push_back(0.5 * (vertices[a] + vertices[b]));
+      parents.emplace_back(a, b);
+    }
+  const unsigned int m = midpoint->second;
+
+  const Cell cell = cells[c];
+
+  // The halves keep the orientation of the cell.
+  Cell first  = cell;
+  Cell second = cell;
+    for (unsigned int v = 0; v < n_cell_vertices; ++v) {
+      if (first[v] == b)
+        first[v] = m;
+      if (second[v] == a)
+        second[v] = m;
+    }
+
+    // A boundary face on the edge is split as well.
+    if (!boundary_ids.empty()) {
+        for (unsigned int k = 0; k < n_cell_vertices; ++k) {
+          if (cell[k] == a || cell[k] == b)
+            continue;
+
+          const auto boundary = boundary_ids.find(face(cell, k));
+          if (boundary == boundary_ids.end())
+            continue;
+
+          // The k-th vertex is in both halves, at the same place.
+          const types::boundary_id id = boundary->second;
+          boundary_ids.erase(boundary);
+          boundary_ids[face(first, k)]  = id;
+          boundary_ids[face(second, k)] = id;
+        }
+    }
+
+  cells[c] = first;
+  cells.push_back(second);
+  material_ids.push_back(material_ids[c]);
+  roots.push_back(roots[c]);
+}
+
+#endif
@@ -0,0 +1,507 @@
+#ifndef TIME_SERIES_WRITER_HPP
+#define TIME_SERIES_WRITER_HPP
+
+#include <deal.II/base/data_out_base.h>
+#include <deal.II/base/mpi.h>
+
+#include <hdf5.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace dealii;
+
+// Time series of a nodal field. Coordinates and connectivity are written to
+// <prefix>.h5 once per mesh, every snapshot is appended to the same file as a
+// new (chunked, optionally compressed) dataset with its index, time and mesh
+// as attributes, and <prefix>.xdmf lists all the snapshots in one temporal
+// collection, each on its mesh.
+template <int dim>
+class TimeSeriesWriter {
+public:
+  // Compression level of the datasets, from 0 (none) to 9. A restarted run
+  // appends to the file of the previous one, if any, instead of replacing it,
+  // adding its mesh if the nodes are not those of the last snapshot kept (a
+  // restart on another number of processes).
+  TimeSeriesWriter(const std::string  &prefix_,
+                   const unsigned int &compression_level_,
+                   const MPI_Comm     &comm_,
+                   const bool         &restart_ = false) :
+    prefix(prefix_), compression_level(compression_level_), comm(comm_), restart(restart_) {}
+
+  ~TimeSeriesWriter() {
+    if (file >= 0)
+      H5Fclose(file);
+  }
+
+  // Append the first data set of the filter, which also provides the mesh on
+  // the first call and after change_mesh(). Collective.
+  void
+  write(const DataOutBase::DataOutFilter &data_filter,
+        const unsigned int               &index,
+        const double                     &time);
+
+  // The next snapshots are on a new mesh.
+  void
+  change_mesh() {
+    mesh_changed = true;
+  }
+
+private:
+  // Open the file of the run being restarted, if it exists. The snapshots
+  // before first_index are listed again, and the later ones, written after
+  // the checkpoint, are deleted. The next snapshots go on the mesh of the last
+  // one if it has the nodes of the filter in the same order, and on a new
+  // mesh otherwise. Collective.
+  bool
+  open_existing(const DataOutBase::DataOutFilter &data_filter,
+                const unsigned int               &first_index);
+
+  // Coordinates of the nodes of the filter, n_coordinates per node.
+  std::vector<double>
+  node_coordinates(const DataOutBase::DataOutFilter &data_filter) const;
+
+  // Write the mesh of the filter as a new mesh of the file.
+  void
+  write_mesh(const DataOutBase::DataOutFilter &data_filter);
+
+  // Names of the datasets of the coordinates and of the connectivity of the
+  // k-th mesh of the file.
+  static std::string
+  mesh_dataset_name(const std::string &name, const unsigned int &k) {
+    return k == 0 ? name : name + "_" + std::to_string(k);
+  }
+
+  // Write a dataset of n_columns columns, each process contributing its rows
+  // one after the other.
+  template <typename T>
+  void
+  write_rows(const std::string    &name,
+             const hid_t          &type,
+             const std::vector<T> &data,
+             const unsigned int   &n_columns) const;
+
+  // Rewrite the XDMF file with all the snapshots so far (first process only).
+  void
+  write_xdmf() const;
+
+  const std::string  prefix;
+  const unsigned int compression_level;
+  const MPI_Comm     comm;
+  const bool         restart;
+
+  // HDF5 file, open from the first snapshot on (negative before).
+  hid_t file = -1;
+
+  // Size of every mesh of the file.
+  struct MeshSize {
+    unsigned long long n_global_nodes = 0;
+    unsigned long long n_global_cells = 0;
+    unsigned int       nodes_per_cell = 0;
+  };
+
+  std::vector<MeshSize> meshes;
+
+  // Mesh of the next snapshot, and whether it is not in the file yet.
+  unsigned int current_mesh = 0;
+  bool         mesh_changed = false;
+
+  // Coordinates per node in the file.
+  static constexpr unsigned int n_coordinates = (dim == 1) ? 2 : dim;
+
+  // Time, dataset name and mesh of every snapshot, in the order they were
+  // written.
+  struct Snapshot {
+    double       time;
+    std::string  name;
+    unsigned int mesh;
+  };
+
+  std::vector<Snapshot> snapshots;
+};
+
+template <int dim>
+void
+TimeSeriesWriter<dim>::write(const DataOutBase::DataOutFilter &data_filter,
+                             const unsigned int               &index,
+                             const double                     &time) {
+    if (file < 0 && !(restart && open_existing(data_filter, index))) {
+      hid_t access = H5Pcreate(H5P_FILE_ACCESS);
+      H5Pset_fapl_mpio(access, comm, MPI_INFO_NULL);
+      file = H5Fcreate((prefix + ".h5").c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, access);
+      H5Pclose(access);
+
+      AssertThrow(file >= 0, ExcMessage("Cannot create " + prefix + ".h5"));
+
+      write_mesh(data_filter);
+    } else if (mesh_changed) {
+      write_mesh(data_filter);
+    }
+
+  mesh_changed = false;
+
+  // Six digits keep the datasets sorted in viewers up to 999999 snapshots;
+  // the order of the series is given by the index attribute.
+  std::ostringstream name;
+  name << "u_" << std::setw(6) << std::setfill('0') << index;
+
+  const double       *values = data_filter.get_data_set(0);
+  std::vector<double> data(values, values + data_filter.n_nodes());
+  write_rows(name.str(), H5T_NATIVE_DOUBLE, data, 1);
+
+  // The index, time and mesh go with the dataset, so that a restart can list
+  // it again.
+  hid_t dataset = H5Dopen2(file, name.str().c_str(), H5P_DEFAULT);
+  hid_t scalar  = H5Screate(H5S_SCALAR);
+  hid_t attribute =
+    H5Acreate2(dataset, "index", H5T_NATIVE_UINT, scalar, H5P_DEFAULT, H5P_DEFAULT);
+  H5Awrite(attribute, H5T_NATIVE_UINT, &index);
+  H5Aclose(attribute);
+  attribute = H5Acreate2(dataset, "time", H5T_NATIVE_DOUBLE, scalar, H5P_DEFAULT, H5P_DEFAULT);
+  H5Awrite(attribute, H5T_NATIVE_DOUBLE, &time);
+  H5Aclose(attribute);
+  attribute = H5Acreate2(dataset, "mesh", H5T_NATIVE_UINT, scalar, H5P_DEFAULT, H5P_DEFAULT);
+  H5Awrite(attribute, H5T_NATIVE_UINT, &current_mesh);
+  H5Aclose(attribute);
+  H5Sclose(scalar);
+  H5Dclose(dataset);
+
+  H5Fflush(file, H5F_SCOPE_GLOBAL);
+
+  snapshots.push_back({time, name.str(), current_mesh});
+
+  if (Utilities::MPI::this_mpi_process(comm) == 0)
+    write_xdmf();
+}
+
+template <int dim>
+bool
+TimeSeriesWriter<dim>::open_existing(const DataOutBase::DataOutFilter &data_filter,
+                                     const unsigned int               &first_index) {
+  const std::string file_name = prefix + ".h5";
+
+  // The first process decides for all, in case the file system is not shared.
+  const bool exists =
+    Utilities::MPI::max((Utilities::MPI::this_mpi_process(comm) == 0 &&
+                         std::ifstream(file_name).good()) ?
+                          1u :
+                          0u,
+                        comm) > 0;
+  if (!exists)
+    return false;
+
+  hid_t access = H5Pcreate(H5P_FILE_ACCESS);
+  H5Pset_fapl_mpio(access, comm, MPI_INFO_NULL);
+  file = H5Fopen(file_name.c_str(), H5F_ACC_RDWR, access);
+  H5Pclose(access);
+
+  AssertThrow(file >= 0, ExcMessage("Cannot open " + file_name));
+
+  // Number of rows and columns of a dataset of the file.
+  const auto extent = [this](const std::string &name) {
+    hsize_t dims[2] = {0, 0};
+    hid_t   dataset = H5Dopen2(file, name.c_str(), H5P_DEFAULT);
+    AssertThrow(dataset >= 0, ExcMessage(prefix + ".h5 has no dataset " + name));
+    hid_t space = H5Dget_space(dataset);
+    H5Sget_simple_extent_dims(space, dims, nullptr);
+    H5Sclose(space);
+    H5Dclose(dataset);
+    return std::make_pair(dims[0], dims[1]);
+  };
+
+  // Meshes of the file, in the order they were written.
+    for (unsigned int k = 0;
+         H5Lexists(file, mesh_dataset_name("nodes", k).c_str(), H5P_DEFAULT) > 0;
+         ++k) {
+      const auto nodes_extent = extent(mesh_dataset_name("nodes", k));
+      const auto cells_extent = extent(mesh_dataset_name("cells", k));
+
+      AssertThrow(nodes_extent.second == n_coordinates,
+                  ExcMessage(prefix + ".h5 was written in another dimension."));
+
+      MeshSize mesh_size;
+      mesh_size.n_global_nodes = nodes_extent.first;
+      mesh_size.n_global_cells = cells_extent.first;
+      mesh_size.nodes_per_cell = cells_extent.second;
+      meshes.push_back(mesh_size);
+    }
+
+  AssertThrow(!meshes.empty(), ExcMessage(prefix + ".h5 has no mesh."));
+
+  // Snapshot datasets with their index, listed before any of them is
+  // deleted.
+  H5G_info_t info;
+  H5Gget_info(file, &info);
+
+  std::vector<std::pair<unsigned int, std::string>> names;
+    for (hsize_t k = 0; k < info.nlinks; ++k) {
+      const ssize_t length = H5Lget_name_by_idx(
+        file, ".", H5_INDEX_NAME, H5_ITER_INC, k, nullptr, 0, H5P_DEFAULT);
+      std::string name(length, '\0');
+      H5Lget_name_by_idx(
+        file, ".", H5_INDEX_NAME, H5_ITER_INC, k, name.data(), length + 1, H5P_DEFAULT);
+
+      if (name.compare(0, 2, "u_") != 0)
+        continue;
+
+      // Older files only have the index in the name.
+      unsigned int index   = std::stoul(name.substr(2));
+      hid_t        dataset = H5Dopen2(file, name.c_str(), H5P_DEFAULT);
+        if (H5Aexists(dataset, "index") > 0) {
+          hid_t attribute = H5Aopen(dataset, "index", H5P_DEFAULT);
+          H5Aread(attribute, H5T_NATIVE_UINT, &index);
+          H5Aclose(attribute);
+        }
+      H5Dclose(dataset);
+
+      names.emplace_back(index, name);
+    }
+
+  // The indices give the order of the snapshots, which the names only do up
+  // to six digits.
+  std::sort(names.begin(), names.end());
+
+    for (const auto &[index, name] : names) {
+        if (index >= first_index) {
+          H5Ldelete(file, name.c_str(), H5P_DEFAULT);
+          continue;
+        }
+
+      double       time    = 0.0;
+      unsigned int mesh    = 0;
+      hid_t        dataset = H5Dopen2(file, name.c_str(), H5P_DEFAULT);
+      AssertThrow(H5Aexists(dataset, "time") > 0,
+                  ExcMessage("The snapshot " + name + " of " + prefix + ".h5 has no time."));
+      hid_t attribute = H5Aopen(dataset, "time", H5P_DEFAULT);
+      H5Aread(attribute, H5T_NATIVE_DOUBLE, &time);
+      H5Aclose(attribute);
+        // Files with a single mesh may not store it.
+        if (H5Aexists(dataset, "mesh") > 0) {
+          attribute = H5Aopen(dataset, "mesh", H5P_DEFAULT);
+          H5Aread(attribute, H5T_NATIVE_UINT, &mesh);
+          H5Aclose(attribute);
+        }
+      H5Dclose(dataset);
+
+      AssertThrow(mesh < meshes.size(),
+                  ExcMessage("The snapshot " + name + " of " + prefix + ".h5 has no mesh."));
+
+      snapshots.push_back({time, name, mesh});
+    }
+
+  current_mesh = snapshots.empty() ? meshes.size() - 1 : snapshots.back().mesh;
+
+  // The snapshots only go on the same mesh if every process has the same
+  // nodes, in the same order, as the run that wrote it (same mesh, degree and
+  // partition). Each process compares its own rows.
+  const std::vector<double> nodes   = node_coordinates(data_filter);
+  const unsigned long long  n_nodes = data_filter.n_nodes();
+
+  unsigned long long offset = 0;
+  MPI_Exscan(&n_nodes, &offset, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, comm);
+  if (Utilities::MPI::this_mpi_process(comm) == 0)
+    offset = 0;
+
+  bool same_mesh = Utilities::MPI::sum(n_nodes, comm) == meshes[current_mesh].n_global_nodes;
+
+    if (same_mesh) {
+      std::vector<double> file_nodes(nodes.size());
+
+      const hsize_t start[2] = {offset, 0};
+      const hsize_t count[2] = {n_nodes, n_coordinates};
+
+      hid_t dataset =
+        H5Dopen2(file, mesh_dataset_name("nodes", current_mesh).c_str(), H5P_DEFAULT);
+      hid_t file_space   = H5Dget_space(dataset);
+      hid_t memory_space = H5Screate_simple(2, count, nullptr);
+
+        if (n_nodes > 0) {
+          H5Sselect_hyperslab(file_space, H5S_SELECT_SET, start, nullptr, count, nullptr);
+        } else {
+          H5Sselect_none(file_space);
+          H5Sselect_none(memory_space);
+        }
+
+      hid_t transfer = H5Pcreate(H5P_DATASET_XFER);
+      H5Pset_dxpl_mpio(transfer, H5FD_MPIO_COLLECTIVE);
+      H5Dread(dataset, H5T_NATIVE_DOUBLE, memory_space, file_space, transfer, file_nodes.data());
+
+      H5Pclose(transfer);
+      H5Sclose(memory_space);
+      H5Sclose(file_space);
+      H5Dclose(dataset);
+
+      same_mesh = Utilities::MPI::min(file_nodes == nodes ? 1u : 0u, comm) > 0;
+    }
+
+  mesh_changed = !same_mesh;
+
+  return true;
+}
+
+template <int dim>
+std::vector<double>
+TimeSeriesWriter<dim>::node_coordinates(const DataOutBase::DataOutFilter &data_filter) const {
+  std::vector<double> nodes;
+  data_filter.fill_node_data(nodes);
+
+    // XDMF has no one-dimensional geometry: lines get a zero y coordinate.
+    if (dim == 1) {
+      std::vector<double> nodes_xy(2 * nodes.size(), 0.0);
+      for (unsigned int i = 0; i < nodes.size(); ++i)
+        nodes_xy[2 * i] = nodes[i];
+      nodes.swap(nodes_xy);
+    }
+
+  return nodes;
+}
+
+template <int dim>
+void
+TimeSeriesWriter<dim>::write_mesh(const DataOutBase::DataOutFilter &data_filter) {
+  const unsigned long long n_nodes = data_filter.n_nodes();
+
+  // Cells refer to nodes by their global index.
+  unsigned long long node_offset = 0;
+  MPI_Exscan(&n_nodes, &node_offset, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, comm);
+  if (Utilities::MPI::this_mpi_process(comm) == 0)
+    node_offset = 0;
+
+  const std::vector<double> nodes = node_coordinates(data_filter);
+  std::vector<unsigned int> cells;
+  data_filter.fill_cell_data(static_cast<unsigned int>(node_offset), cells);
+
+  MeshSize mesh_size;
+  mesh_size.n_global_nodes = Utilities::MPI::sum(n_nodes, comm);
+  mesh_size.n_global_cells =
+    Utilities::MPI::sum(static_cast<unsigned long long>(data_filter.n_cells()), comm);
+  // Processes without cells do not know the cell type.
+  const unsigned int local_nodes_per_cell =
+    data_filter.n_cells() > 0 ? cells.size() / data_filter.n_cells() : 0;
+  mesh_size.nodes_per_cell = Utilities::MPI::max(local_nodes_per_cell, comm);
+
+  current_mesh = meshes.size();
+  write_rows(mesh_dataset_name("nodes", current_mesh), H5T_NATIVE_DOUBLE, nodes, n_coordinates);
+  write_rows(
+    mesh_dataset_name("cells", current_mesh), H5T_NATIVE_UINT, cells, mesh_size.nodes_per_cell);
+
+  meshes.push_back(mesh_size);
+}
+
+template <int dim>
+template <typename T>
+void
+TimeSeriesWriter<dim>::write_rows(const std::string    &name,
+                                  const hid_t          &type,
+                                  const std::vector<T> &data,
+                                  const unsigned int   &n_columns) const {
+  const unsigned long long n_rows = data.size() / n_columns;
+
+  unsigned long long offset = 0;
+  MPI_Exscan(&n_rows, &offset, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, comm);
+  if (Utilities::MPI::this_mpi_process(comm) == 0)
+    offset = 0;
+
+  const unsigned long long n_global_rows = Utilities::MPI::sum(n_rows, comm);
+
+  const hsize_t dims[2]  = {n_global_rows, n_columns};
+  const hsize_t start[2] = {offset, 0};
+  const hsize_t count[2] = {n_rows, n_columns};
+
+  hid_t file_space   = H5Screate_simple(2, dims, nullptr);
+  hid_t memory_space = H5Screate_simple(2, count, nullptr);
+
+  hid_t creation = H5Pcreate(H5P_DATASET_CREATE);
+    if (n_global_rows > 0) {
+      const hsize_t chunk[2] = {std::min<hsize_t>(n_global_rows, 1 << 16), n_columns};
+      H5Pset_chunk(creation, 2, chunk);
+
+      if (compression_level > 0)
+        H5Pset_deflate(creation, compression_level);
+    }
+
+  hid_t dataset =
+    H5Dcreate2(file, name.c_str(), type, file_space, H5P_DEFAULT, creation, H5P_DEFAULT);
+  AssertThrow(dataset >= 0, ExcMessage("Cannot create the dataset " + name));
+
+    if (n_rows > 0) {
+      H5Sselect_hyperslab(file_space, H5S_SELECT_SET, start, nullptr, count, nullptr);
+    } else {
+      H5Sselect_none(file_space);
+      H5Sselect_none(memory_space);
+    }
+
+  // Compressed datasets can only be written collectively.
+  hid_t transfer = H5Pcreate(H5P_DATASET_XFER);
+  H5Pset_dxpl_mpio(transfer, H5FD_MPIO_COLLECTIVE);
+
+  const herr_t status =
+    H5Dwrite(dataset, type, memory_space, file_space, transfer, data.data());
+  AssertThrow(status >= 0, ExcMessage("Cannot write the dataset " + name));
+
+  H5Pclose(transfer);
+  H5Dclose(dataset);
+  H5Pclose(creation);
+  H5Sclose(memory_space);
+  H5Sclose(file_space);
+}
+
+template <int dim>
+void
+TimeSeriesWriter<dim>::write_xdmf() const {
+  const std::string h5_file_name = prefix + ".h5";
+
+  std::ofstream xdmf(prefix + ".xdmf");
+
+  xdmf << "<?xml version=\"1.0\" ?>\n"
+       << "<!DOCTYPE Xdmf SYSTEM \"Xdmf.dtd\" []>\n"
+       << "<Xdmf Version=\"2.0\">\n"
+       << "  <Domain>\n"
+       << "    <Grid Name=\"CellTime\" GridType=\"Collection\" CollectionType=\"Temporal\">\n";
+
+    for (const Snapshot &snapshot : snapshots) {
+      const MeshSize &mesh_size = meshes[snapshot.mesh];
+
+      std::string topology;
+      if (dim == 3)
+        topology = (mesh_size.nodes_per_cell == 4) ? "Tetrahedron" : "Hexahedron";
+      else if (dim == 2)
+        topology = (mesh_size.nodes_per_cell == 3) ? "Triangle" : "Quadrilateral";
+      else
+        topology = "Polyline";
+
+      xdmf << "      <Grid Name=\"mesh\" GridType=\"Uniform\">\n"
+           << "        <Time Value=\"" << std::setprecision(17) << snapshot.time << "\"/>\n"
+           << "        <Geometry GeometryType=\"" << (dim == 3 ? "XYZ" : "XY") << "\">\n"
+           << "          <DataItem Dimensions=\"" << mesh_size.n_global_nodes << " "
+           << n_coordinates << "\" NumberType=\"Float\" Precision=\"8\" Format=\"HDF\">"
+           << h5_file_name << ":/" << mesh_dataset_name("nodes", snapshot.mesh)
+           << "</DataItem>\n"
+           << "        </Geometry>\n"
+           << "        <Topology TopologyType=\"" << topology << "\""
+           << (dim == 1 ? " NodesPerElement=\"2\"" : "") << " NumberOfElements=\""
+           << mesh_size.n_global_cells << "\">\n"
+           << "          <DataItem Dimensions=\"" << mesh_size.n_global_cells << " "
+           << mesh_size.nodes_per_cell << "\" NumberType=\"UInt\" Format=\"HDF\">"
+           << h5_file_name << ":/" << mesh_dataset_name("cells", snapshot.mesh)
+           << "</DataItem>\n"
+           << "        </Topology>\n"
+           << "        <Attribute Name=\"u\" AttributeType=\"Scalar\" Center=\"Node\">\n"
+           << "          <DataItem Dimensions=\"" << mesh_size.n_global_nodes
+           << " 1\" NumberType=\"Float\" Precision=\"8\" Format=\"HDF\">" << h5_file_name
+           << ":/" << snapshot.name << "</DataItem>\n"
+           << "        </Attribute>\n"
+           << "      </Grid>\n";
+    }
+
+  xdmf << "    </Grid>\n"
+       << "  </Domain>\n"
+       << "</Xdmf>\n";
+}
+
+#endif
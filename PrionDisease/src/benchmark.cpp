@@ -0,0 +1,238 @@
+#include <fstream>
+#include <sstream>
+
+#include "Prion.hpp"
+
+// Mesh of the benchmark suite, with the seed of the initial condition (which
+// has to lie in the mesh).
+struct BenchmarkMesh {
+  std::string file_name;
+  Point<3>    seed;
+};
+
+// Benchmark suite: every mesh is solved with every degree, process count and
+// thread count, for a fixed number of time steps.
+struct BenchmarkSuite {
+  unsigned int               time_steps    = 10;
+  double                     deltat        = 0.1;
+  unsigned int               output_steps  = 0;
+  unsigned int               kernel_sweeps = 5;
+  std::vector<unsigned int>  degrees       = {1, 2};
+  std::vector<unsigned int>  processes     = {1};
+  std::vector<unsigned int>  threads       = {1};
+  std::vector<BenchmarkMesh> meshes;
+};
+
+// Read a benchmark suite, one key and its values per line:
+//   time_steps <n>             time steps of every run
+//   deltat <dt>                time step
+//   output_steps <n>           time steps between two outputs (0: none)
+//   kernel_sweeps <n>          sweeps of the assembly kernel micro-benchmark
+//   degrees <r> ...            polynomial degrees (1, 2)
+//   processes <p> ...          process counts
+//   threads <t> ...            threads per process
+//   mesh <file> <x> <y> <z>    mesh and seed of the initial condition
+// Empty lines and lines starting with # are skipped.
+BenchmarkSuite
+read_suite(const std::string &file_name) {
+  std::ifstream file(file_name);
+  AssertThrow(file, ExcMessage("Cannot open the benchmark file " + file_name));
+
+  BenchmarkSuite suite;
+  std::string    line;
+
+  const auto check = [&line](const bool &valid) {
+    AssertThrow(valid, ExcMessage("Malformed benchmark line: " + line));
+  };
+
+  const auto read_list = [&](std::istringstream &fields, std::vector<unsigned int> &list) {
+    list.clear();
+    for (unsigned int value; fields >> value;)
+      list.push_back(value);
+    check(!list.empty());
+  };
+
+    while (std::getline(file, line)) {
+      if (line.empty() || line[0] == '#')
+        continue;
+
+      std::istringstream fields(line);
+      std::string        key;
+      fields >> key;
+
+        if (key == "time_steps") {
+          check(static_cast<bool>(fields >> suite.time_steps));
+        } else if (key == "deltat") {
+          check(static_cast<bool>(fields >> suite.deltat));
+        } else if (key == "output_steps") {
+          check(static_cast<bool>(fields >> suite.output_steps));
+        } else if (key == "kernel_sweeps") {
+          check(static_cast<bool>(fields >> suite.kernel_sweeps));
+        } else if (key == "degrees") {
+          read_list(fields, suite.degrees);
+        } else if (key == "processes") {
+          read_list(fields, suite.processes);
+        } else if (key == "threads") {
+          read_list(fields, suite.threads);
+        } else if (key == "mesh") {
+          BenchmarkMesh mesh;
+          check(static_cast<bool>(fields >> mesh.file_name >> mesh.seed[0] >> mesh.seed[1] >>
+                                  mesh.seed[2]));
+          suite.meshes.push_back(mesh);
+        } else {
+          AssertThrow(false, ExcMessage("Unknown benchmark key: " + key));
+        }
+    }
+
+  return suite;
+}
+
+// Set up and solve one configuration of the suite on the given communicator,
+// and return its record (on the first process of comm only).
+template <unsigned int degree>
+std::string
+run(const BenchmarkSuite &suite,
+    const BenchmarkMesh  &benchmark_mesh,
+    const unsigned int   &n_threads,
+    const MPI_Comm       &comm) {
+  const double T = suite.time_steps * suite.deltat;
+
+  // Optimized solver, with a fixed time step so that every run does the same
+  // amount of work.
+  HeatNonLinearSettings settings;
+  settings.mesh_file_name     = benchmark_mesh.file_name;
+  settings.preconditioner     = HeatNonLinearSettings::Preconditioner::amg;
+  settings.cache_geometry     = true;
+  settings.vectorize_assembly = true;
+  settings.forcing_term       = HeatNonLinearSettings::ForcingTerm::eisenstat_walker;
+  settings.n_threads          = n_threads;
+  settings.output_interval    = suite.output_steps * suite.deltat;
+  settings.output_prefix      = "benchmark-output";
+  settings.print_progress     = false;
+
+  HeatNonLinearScenario scenario;
+  scenario.seed   = benchmark_mesh.seed;
+  scenario.T      = T;
+  scenario.deltat = suite.deltat;
+
+  Timer timer(comm);
+
+  HeatNonLinear<3, degree> problem(0, T, suite.deltat, settings, comm);
+  problem.set_scenario(scenario);
+  problem.setup();
+
+  // The micro-benchmark is not timed by the sections of the solver.
+  timer.stop();
+  const auto kernels = problem.measure_assembly_kernels(suite.kernel_sweeps);
+  timer.start();
+
+  problem.solve();
+
+  timer.stop();
+
+  const double wall_time = Utilities::MPI::max(timer.wall_time(), comm);
+  const auto   sections  = problem.section_times();
+
+  std::ostringstream record;
+  record << std::setprecision(9) << "    {\"mesh\": \"" << benchmark_mesh.file_name
+         << "\", \"degree\": " << degree
+         << ", \"processes\": " << Utilities::MPI::n_mpi_processes(comm)
+         << ", \"threads\": " << MultithreadInfo::n_threads()
+         << ", \"cells\": " << problem.n_cells() << ", \"dofs\": " << problem.n_dofs()
+         << ",\n     \"time_steps\": " << problem.n_time_steps()
+         << ", \"newton_iterations\": " << problem.n_newton_iterations()
+         << ", \"linear_iterations\": " << problem.n_linear_iterations()
+         << ", \"wall_time\": " << wall_time << ",\n     \"sections\": {";
+
+  bool first = true;
+    for (const auto &[section, time] : sections) {
+      record << (first ? "" : ",") << "\n       \"" << section << "\": {\"min\": " << time.min
+             << ", \"max\": " << time.max << ", \"avg\": " << time.avg << "}";
+      first = false;
+    }
+
+  record << "},\n     \"assembly_kernels_ns_per_cell\": {\"fe_values\": "
+         << kernels.fe_values * 1e9 << ", \"cached\": " << kernels.cached * 1e9
+         << ", \"batch\": " << kernels.batch * 1e9 << "}}";
+
+  return record.str();
+}
+
+// Strong and weak scaling benchmark. The process counts of the suite are run
+// on the first processes of MPI_COMM_WORLD, the others waiting, so one launch
+// on the largest count covers them all. Strong scaling is read along the
+// process counts of one mesh, weak scaling across meshes at comparable DoFs
+// per process. The records go to a JSON file (benchmark.json by default).
+int
+main(int argc, char *argv[]) {
+  Utilities::MPI::MPI_InitFinalize mpi_init(argc, argv);
+
+  const unsigned int mpi_size = Utilities::MPI::n_mpi_processes(MPI_COMM_WORLD);
+  const unsigned int mpi_rank = Utilities::MPI::this_mpi_process(MPI_COMM_WORLD);
+
+    if (argc < 2) {
+      if (mpi_rank == 0)
+        std::cerr << "Usage: " << argv[0] << " <benchmark file> [output.json]" << std::endl;
+      return 1;
+    }
+
+  const BenchmarkSuite suite       = read_suite(argv[1]);
+  const std::string    output_file = (argc > 2) ? argv[2] : "benchmark.json";
+
+  std::vector<std::string> records;
+
+    for (const auto &benchmark_mesh : suite.meshes) {
+        // Meshes too large for the repository may be missing.
+        if (!std::ifstream(benchmark_mesh.file_name)) {
+          if (mpi_rank == 0)
+            std::cerr << "Skipping " << benchmark_mesh.file_name << ": cannot open it"
+                      << std::endl;
+          continue;
+        }
+
+        for (const unsigned int &degree : suite.degrees) {
+          AssertThrow(degree == 1 || degree == 2, ExcMessage("Only P1 and P2 are built."));
+
+            for (const unsigned int &n_processes : suite.processes) {
+                if (n_processes > mpi_size) {
+                  if (mpi_rank == 0)
+                    std::cerr << "Skipping " << n_processes << " processes: only "
+                              << mpi_size << " available" << std::endl;
+                  continue;
+                }
+
+              MPI_Comm comm;
+              MPI_Comm_split(
+                MPI_COMM_WORLD, mpi_rank < n_processes ? 0 : MPI_UNDEFINED, mpi_rank, &comm);
+
+                if (comm != MPI_COMM_NULL) {
+                    for (const unsigned int &n_threads : suite.threads) {
+                      const std::string record =
+                        (degree == 1) ? run<1>(suite, benchmark_mesh, n_threads, comm) :
+                                        run<2>(suite, benchmark_mesh, n_threads, comm);
+                      records.push_back(record);
+                    }
+
+                  MPI_Comm_free(&comm);
+                }
+
+              MPI_Barrier(MPI_COMM_WORLD);
+            }
+        }
+    }
+
+  // The first process takes part in every run.
+    if (mpi_rank == 0) {
+      std::ofstream file(output_file);
+      file << "{\n  \"time_steps\": " << suite.time_steps << ",\n  \"deltat\": "
+           << suite.deltat << ",\n  \"simd_lanes\": " << VectorizedArray<double>::size()
+           << ",\n  \"runs\": [\n";
+      for (unsigned int k = 0; k < records.size(); ++k)
+        file << records[k] << (k + 1 < records.size() ? ",\n" : "\n");
+      file << "  ]\n}" << std::endl;
+
+      std::cout << "Wrote " << records.size() << " runs to " << output_file << std::endl;
+    }
+
+  return 0;
+}
@@ -0,0 +1,64 @@
+#include <deal.II/base/mpi.h>
+
+#include <deal.II/grid/grid_in.h>
+#include <deal.II/grid/grid_tools.h>
+#include <deal.II/grid/tria.h>
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+#include "MeshCache.hpp"
+
+// Read a Gmsh mesh of the given dimension, partition it and write the cache.
+template <int dim>
+void
+convert(const std::string  &input_file_name,
+        const unsigned int &n_partitions,
+        const std::string  &output_file_name) {
+  Triangulation<dim> mesh;
+
+  GridIn<dim> grid_in;
+  grid_in.attach_triangulation(mesh);
+  std::ifstream grid_in_file(input_file_name);
+  AssertThrow(grid_in_file, ExcMessage("Cannot open the mesh file " + input_file_name));
+  grid_in.read_msh(grid_in_file);
+
+  GridTools::partition_triangulation(n_partitions, mesh);
+
+  MeshCache::write(mesh, n_partitions, output_file_name);
+
+  std::cout << "Wrote " << mesh.n_active_cells() << " cells and " << mesh.n_vertices()
+            << " vertices of a " << dim << "D mesh, partitioned for " << n_partitions
+            << " processes, to " << output_file_name << std::endl;
+}
+
+// Convert a Gmsh mesh into a mesh cache partitioned for a given number of
+// processes, to be read by HeatNonLinear::setup(). The mesh is 3D unless
+// another dimension is given.
+int
+main(int argc, char *argv[]) {
+  Utilities::MPI::MPI_InitFinalize mpi_init(argc, argv, 1);
+
+  const int dim = argc == 5 ? std::atoi(argv[4]) : 3;
+
+    if ((argc != 4 && argc != 5) || dim < 1 || dim > 3) {
+      std::cerr << "Usage: " << argv[0]
+                << " <mesh.msh> <n_processes> <output file> [<dimension: 1, 2 or 3>]"
+                << std::endl;
+      return 1;
+    }
+
+  const std::string  input_file_name  = argv[1];
+  const unsigned int n_partitions     = static_cast<unsigned int>(std::stoi(argv[2]));
+  const std::string  output_file_name = argv[3];
+
+  if (dim == 1)
+    convert<1>(input_file_name, n_partitions, output_file_name);
+  else if (dim == 2)
+    convert<2>(input_file_name, n_partitions, output_file_name);
+  else
+    convert<3>(input_file_name, n_partitions, output_file_name);
+
+  return 0;
+}
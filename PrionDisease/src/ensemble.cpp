@@ -0,0 +1,139 @@
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+#include "Prion.hpp"
+
+// Read the scenarios of an ensemble, one per line:
+//   name alpha d_ext d_axn axon_x axon_y axon_z seed_x seed_y seed_z T deltat
+// Empty lines and lines starting with # are skipped.
+std::vector<HeatNonLinearScenario>
+read_scenarios(const std::string &file_name) {
+  std::ifstream file(file_name);
+  AssertThrow(file, ExcMessage("Cannot open the scenario file " + file_name));
+
+  std::vector<HeatNonLinearScenario> scenarios;
+  std::string                        line;
+
+    while (std::getline(file, line)) {
+      if (line.empty() || line[0] == '#')
+        continue;
+
+      std::istringstream    fields(line);
+      HeatNonLinearScenario scenario;
+
+      scenario.axon_direction.resize(3);
+      fields >> scenario.name >> scenario.alpha >> scenario.d_ext >> scenario.d_axn >>
+        scenario.axon_direction[0] >> scenario.axon_direction[1] >>
+        scenario.axon_direction[2] >> scenario.seed[0] >> scenario.seed[1] >>
+        scenario.seed[2] >> scenario.T >> scenario.deltat;
+
+      AssertThrow(fields, ExcMessage("Malformed scenario: " + line));
+
+      scenarios.push_back(scenario);
+    }
+
+  return scenarios;
+}
+
+// Run an ensemble of scenarios on the same mesh. The processes are split into
+// groups, each of which sets up the problem once and then solves its share of
+// the scenarios one after the other. A summary of all the runs is written to
+// ensemble-summary.csv.
+int
+main(int argc, char *argv[]) {
+  Utilities::MPI::MPI_InitFinalize mpi_init(argc, argv);
+
+  const unsigned int mpi_size = Utilities::MPI::n_mpi_processes(MPI_COMM_WORLD);
+  const unsigned int mpi_rank = Utilities::MPI::this_mpi_process(MPI_COMM_WORLD);
+
+  // Anything but a positive number of groups is rejected.
+  const int n_groups_requested = argc > 2 ? std::atoi(argv[2]) : mpi_size;
+
+    if (argc < 2 || n_groups_requested < 1) {
+      if (mpi_rank == 0)
+        std::cerr << "Usage: " << argv[0] << " <scenario file> [number of groups, at least 1]"
+                  << std::endl;
+      return 1;
+    }
+
+  const std::vector<HeatNonLinearScenario> scenarios = read_scenarios(argv[1]);
+
+  const unsigned int n_groups = std::min<unsigned int>(n_groups_requested, mpi_size);
+  const unsigned int group = mpi_rank * n_groups / mpi_size;
+
+  MPI_Comm group_comm;
+  MPI_Comm_split(MPI_COMM_WORLD, group, mpi_rank, &group_comm);
+
+  const bool group_leader = (Utilities::MPI::this_mpi_process(group_comm) == 0);
+
+  const unsigned int N = 19;
+
+  HeatNonLinearSettings settings;
+  settings.preconditioner      = HeatNonLinearSettings::Preconditioner::amg;
+  settings.cache_geometry      = true;
+  settings.forcing_term        = HeatNonLinearSettings::ForcingTerm::eisenstat_walker;
+  settings.analytics_file_name = "analytics.csv";
+
+  // Summary of the runs of this group: index, time steps, final integral,
+  // final maximum and wall time of every scenario.
+  std::vector<double> summary;
+
+    {
+      HeatNonLinear<3, 1> problem(N, 0.0, 0.0, settings, group_comm);
+
+      problem.set_scenario(scenarios.empty() ? HeatNonLinearScenario() : scenarios[0]);
+      problem.setup();
+
+        for (unsigned int i = group; i < scenarios.size(); i += n_groups) {
+          Timer timer(group_comm);
+
+          problem.set_scenario(scenarios[i]);
+          problem.solve();
+
+          timer.stop();
+
+          const double integral  = problem.integral();
+          const double max_value = problem.max_value();
+
+          if (group_leader)
+            summary.insert(summary.end(),
+                           {static_cast<double>(i),
+                            static_cast<double>(problem.n_time_steps()),
+                            integral,
+                            max_value,
+                            timer.wall_time()});
+        }
+    }
+
+  const std::vector<std::vector<double>> summaries =
+    Utilities::MPI::gather(MPI_COMM_WORLD, summary, 0);
+
+    if (mpi_rank == 0) {
+      std::ofstream file("ensemble-summary.csv");
+      file << "scenario,name,group,time_steps,integral,max,wall_time" << std::endl;
+
+      // One row per scenario, in the order of the scenario file.
+      std::vector<std::string> rows(scenarios.size());
+
+        for (unsigned int rank = 0; rank < summaries.size(); ++rank) {
+            for (unsigned int k = 0; k + 5 <= summaries[rank].size(); k += 5) {
+              const unsigned int i = static_cast<unsigned int>(summaries[rank][k]);
+
+              std::ostringstream row;
+              row << std::setprecision(12) << i << "," << scenarios[i].name << ","
+                  << rank * n_groups / mpi_size << "," << summaries[rank][k + 1] << ","
+                  << summaries[rank][k + 2] << "," << summaries[rank][k + 3] << ","
+                  << summaries[rank][k + 4];
+              rows[i] = row.str();
+            }
+        }
+
+      for (const auto &row : rows)
+        file << row << std::endl;
+    }
+
+  MPI_Comm_free(&group_comm);
+
+  return 0;
+}
@@ -1,20 +1,38 @@
 #include "Prion.hpp"
 
-// Main function.
-int
-main(int argc, char *argv[]) {
-  Utilities::MPI::MPI_InitFinalize mpi_init(argc, argv);
-
-  const unsigned int N      = 19;
-  const unsigned int degree = 1;
+// Set up and solve the problem with elements of the given degree.
+template <unsigned int degree>
+void
+run(const HeatNonLinearSettings &settings) {
+  const unsigned int N = 19;
 
   const double T      = 10.0;
   const double deltat = 0.1;
 
-  HeatNonLinear problem(N, degree, T, deltat);
+  HeatNonLinear<3, degree> problem(N, T, deltat, settings);
 
   problem.setup();
   problem.solve();
+}
+
+// Main function.
+int
+main(int argc, char *argv[]) {
+  Utilities::MPI::MPI_InitFinalize mpi_init(argc, argv);
+
+  // The number of threads per process and the degree (1 or 2) can be given
+  // on the command line.
+  HeatNonLinearSettings settings;
+  if (argc > 1)
+    settings.n_threads = static_cast<unsigned int>(std::stoi(argv[1]));
+
+  const unsigned int degree = (argc > 2) ? static_cast<unsigned int>(std::stoi(argv[2])) : 1;
+  AssertThrow(degree == 1 || degree == 2, ExcMessage("Only P1 and P2 are built."));
+
+  if (degree == 1)
+    run<1>(settings);
+  else
+    run<2>(settings);
 
   return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,50 @@
+#include "Prion.hpp"
+
+// Set up and solve the problem with elements of the given degree.
+template <unsigned int degree>
+void
+run(const HeatNonLinearSettings &settings, const HeatNonLinearScenario &scenario) {
+  const unsigned int N = 200;
+
+  HeatNonLinear<1, degree> problem(N, scenario.T, scenario.deltat, settings);
+
+  problem.set_scenario(scenario);
+  problem.setup();
+  problem.solve();
+}
+
+// Fisher-Kolmogorov equation on the unit interval, a fast proxy of the 3D
+// problem.
+int
+main(int argc, char *argv[]) {
+  Utilities::MPI::MPI_InitFinalize mpi_init(argc, argv);
+
+  HeatNonLinearSettings settings;
+  settings.mesh_file_name            = "";
+  settings.newton_absolute_tolerance = 1e-6;
+  settings.output_interval           = 0.1;
+  settings.output_prefix             = "output-1d";
+  settings.analytics_file_name       = "analytics-1d.csv";
+
+  HeatNonLinearScenario scenario;
+  scenario.alpha          = 1.0;
+  scenario.d_ext          = 1e-4;
+  scenario.d_axn          = 0.0;
+  scenario.seed           = Point<3>(0.5, 0.0, 0.0);
+  scenario.seed_amplitude = 0.1;
+  scenario.seed_radius    = 0.1;
+  scenario.seed_sharpness = 30.0;
+  scenario.T              = 30.0;
+  scenario.deltat         = 0.1;
+
+  // The degree (1 or 2) can be given on the command line.
+  const unsigned int degree = (argc > 1) ? static_cast<unsigned int>(std::stoi(argv[1])) : 1;
+  AssertThrow(degree == 1 || degree == 2, ExcMessage("Only P1 and P2 are built."));
+
+  if (degree == 1)
+    run<1>(settings, scenario);
+  else
+    run<2>(settings, scenario);
+
+  return 0;
+}
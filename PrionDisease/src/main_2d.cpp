@@ -0,0 +1,55 @@
+#include "Prion.hpp"
+
+// Set up and solve the problem with elements of the given degree.
+template <unsigned int degree>
+void
+run(const HeatNonLinearSettings &settings, const HeatNonLinearScenario &scenario) {
+  const unsigned int N = 99;
+
+  HeatNonLinear<2, degree> problem(N, scenario.T, scenario.deltat, settings);
+
+  problem.set_scenario(scenario);
+  problem.setup();
+  problem.solve();
+}
+
+// Fisher-Kolmogorov equation on a sagittal section of the brain, given as a
+// 2D Gmsh file, or on the unit square, as a fast proxy of the 3D problem.
+int
+main(int argc, char *argv[]) {
+  Utilities::MPI::MPI_InitFinalize mpi_init(argc, argv);
+
+  HeatNonLinearSettings settings;
+  settings.mesh_file_name      = (argc > 1) ? argv[1] : "";
+  settings.preconditioner      = HeatNonLinearSettings::Preconditioner::amg;
+  settings.cache_geometry      = true;
+  settings.vectorize_assembly  = true;
+  settings.forcing_term        = HeatNonLinearSettings::ForcingTerm::eisenstat_walker;
+  settings.output_interval     = 1.0;
+  settings.output_prefix       = "output-2d";
+  settings.analytics_file_name = "analytics-2d.csv";
+
+  // The brain section uses the coefficients of the 3D problem, the unit
+  // square those of the 1D one.
+  HeatNonLinearScenario scenario;
+    if (settings.mesh_file_name.empty()) {
+      scenario.alpha          = 1.0;
+      scenario.d_ext          = 1e-4;
+      scenario.seed           = Point<3>(0.5, 0.5, 0.0);
+      scenario.seed_amplitude = 0.1;
+      scenario.seed_radius    = 0.1;
+      scenario.seed_sharpness = 30.0;
+      scenario.T              = 30.0;
+    }
+
+  // The degree (1 or 2) can be given on the command line.
+  const unsigned int degree = (argc > 2) ? static_cast<unsigned int>(std::stoi(argv[2])) : 1;
+  AssertThrow(degree == 1 || degree == 2, ExcMessage("Only P1 and P2 are built."));
+
+  if (degree == 1)
+    run<1>(settings, scenario);
+  else
+    run<2>(settings, scenario);
+
+  return 0;
+}